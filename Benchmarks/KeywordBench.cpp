@@ -0,0 +1,119 @@
+// Microbenchmark for keyword recognition on identifier-heavy input.
+// Compares the former unordered_set + unordered_map double lookup against
+// keywordKind(), then reports end-to-end Lexer::tokenize throughput.
+
+#include "../Util/Lexer/Keywords.h"
+#include "../Util/Lexer/Lexer.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// The keyword set and map the Lexer used before keywordKind()
+static const unordered_set<string> legacyKeywords = {
+    "and", "break", "dec", "elif", "else", "false", "if", "inc",
+    "loop", "not", "or", "return", "true", "var",
+    "printi", "printc", "prints", "println",
+    "readi", "reads", "new", "size", "add", "get", "set", "main"
+};
+static const unordered_map<string, TokenKind> legacyKeywordMap = {
+    {"and", TokenKind::AND}, {"break", TokenKind::BREAK},
+    {"dec", TokenKind::DEC}, {"elif", TokenKind::ELIF},
+    {"else", TokenKind::ELSE}, {"if", TokenKind::IF},
+    {"inc", TokenKind::INC}, {"loop", TokenKind::LOOP},
+    {"not", TokenKind::NOT}, {"or", TokenKind::OR},
+    {"return", TokenKind::RETURN}, {"var", TokenKind::VAR},
+    {"printi", TokenKind::PRINTI}, {"printc", TokenKind::PRINTC},
+    {"prints", TokenKind::PRINTS}, {"println", TokenKind::PRINTLN},
+    {"readi", TokenKind::READI}, {"reads", TokenKind::READS},
+    {"new", TokenKind::NEW}, {"size", TokenKind::SIZE},
+    {"add", TokenKind::ADD}, {"get", TokenKind::GET},
+    {"set", TokenKind::SET}, {"main", TokenKind::MAIN}
+};
+
+// The lookup the Lexer used before keywordKind()
+static TokenKind legacyKeywordKind(string_view ident) {
+    string key(ident);
+    if (!legacyKeywords.count(key)) return TokenKind::IDENTIFIER;
+    if (key == "true" || key == "false") return TokenKind::LIT_BOOL;
+    auto it = legacyKeywordMap.find(key);
+    return it != legacyKeywordMap.end() ? it->second : TokenKind::IDENTIFIER;
+}
+
+static string identifierHeavySource(size_t targetBytes) {
+    static const char* words[] = {
+        "i", "n", "first", "sum", "array", "result", "remainder", "is_palindrome",
+        "sort_array", "number_of_days_in_month", "loop", "if", "inc", "get", "set",
+        "size", "var", "return", "prints", "printi", "else", "elif", "break", "and"
+    };
+    mt19937 random(42);
+    uniform_int_distribution<size_t> pick(0, sizeof(words) / sizeof(words[0]) - 1);
+    string source;
+    source.reserve(targetBytes + 64);
+    while (source.size() < targetBytes) {
+        source += words[pick(random)];
+        source += source.size() % 80 < 8 ? '\n' : ' ';
+    }
+    return source;
+}
+
+template <typename Function>
+static double secondsFor(Function&& function) {
+    auto start = chrono::steady_clock::now();
+    function();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    const size_t bytes = 16 * 1024 * 1024;
+    string source = identifierHeavySource(bytes);
+
+    Lexer lexer(source);
+    vector<Token> tokens = lexer.tokenize();
+    vector<string_view> identifiers;
+    identifiers.reserve(tokens.size());
+    for (const auto& token : tokens) {
+        if (token.kind != TokenKind::END_OF_FILE) identifiers.push_back(lexer.text(token));
+    }
+
+    // Timings only count if both lookups agree, on the corpus and on every keyword
+    auto agree = [](string_view ident) {
+        if (legacyKeywordKind(ident) == keywordKind(ident)) return true;
+        fprintf(stderr, "keywordKind disagrees with the legacy lookup on \"%.*s\"\n",
+                static_cast<int>(ident.size()), ident.data());
+        return false;
+    };
+    for (const string& keyword : legacyKeywords) {
+        if (!agree(keyword)) return 1;
+    }
+    for (auto ident : identifiers) {
+        if (!agree(ident)) return 1;
+    }
+
+    size_t checksum = 0;
+    double legacy = secondsFor([&] {
+        for (auto ident : identifiers) checksum += static_cast<size_t>(legacyKeywordKind(ident));
+    });
+    double direct = secondsFor([&] {
+        for (auto ident : identifiers) checksum += static_cast<size_t>(keywordKind(ident));
+    });
+
+    size_t tokenCount = 0;
+    double lexing = secondsFor([&] {
+        Lexer timed(source);
+        tokenCount = timed.tokenize().size();
+    });
+
+    printf("identifiers:           %zu\n", identifiers.size());
+    printf("legacy set+map lookup: %8.2f ns/identifier\n", legacy * 1e9 / identifiers.size());
+    printf("keywordKind lookup:    %8.2f ns/identifier (%.1fx)\n",
+           direct * 1e9 / identifiers.size(), legacy / direct);
+    printf("tokenize:              %8.2f MB/s, %zu tokens\n", bytes / lexing / 1e6, tokenCount);
+    printf("checksum:              %zu\n", checksum);
+    return 0;
+}
@@ -0,0 +1,236 @@
+// Lexer and parser throughput over generated Quetzal programs.
+//
+//   QuetzalBench [--size 64K|16M|500M]... [--seed N] [--depth N]
+//                [--comments F] [--identifiers F] [--json]
+//                [--baseline FILE] [--tolerance F] [--emit FILE]
+//
+// Without --size a 1K/64K/1M/16M sweep runs. --json prints one object per
+// case; feeding a saved run back through --baseline exits with status 1 when
+// any case is slower than the baseline by more than the tolerance (10%).
+// --emit writes the program for the first size to FILE instead of timing it.
+
+#include "SourceGenerator.h"
+#include "../Token/TokenBuffer.h"
+#include "../Util/Lexer/Lexer.h"
+#include "../Util/Parser/Parser.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Allocation counting */
+static atomic<size_t> allocationCount{0};
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+struct CaseResult {
+    string name;
+    size_t bytes = 0;
+    size_t tokens = 0;
+    double lexSeconds = 0;
+    double parseSeconds = 0;
+    double streamSeconds = 0;
+    double lexAllocsPerToken = 0;
+    double parseAllocsPerToken = 0;
+
+    double lexMBps() const { return bytes / lexSeconds / 1e6; }
+    double parseTokensPerSecond() const { return tokens / parseSeconds; }
+    double streamMBps() const { return bytes / streamSeconds / 1e6; }
+};
+
+template <typename Function>
+static double secondsFor(Function&& function) {
+    auto start = chrono::steady_clock::now();
+    function();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static size_t parseSize(const string& text) {
+    char* end = nullptr;
+    double value = strtod(text.c_str(), &end);
+    switch (*end) {
+        case 'k': case 'K': value *= 1024; break;
+        case 'm': case 'M': value *= 1024 * 1024; break;
+        case 'g': case 'G': value *= 1024.0 * 1024 * 1024; break;
+        default: break;
+    }
+    return static_cast<size_t>(value);
+}
+
+static string sizeLabel(size_t bytes) {
+    if (bytes >= 1024 * 1024 && bytes % (1024 * 1024) == 0) return to_string(bytes / (1024 * 1024)) + "M";
+    if (bytes >= 1024 && bytes % 1024 == 0) return to_string(bytes / 1024) + "K";
+    return to_string(bytes);
+}
+
+static CaseResult runCase(const GeneratorOptions& options) {
+    CaseResult result;
+    char name[128];
+    snprintf(name, sizeof name, "size=%s,depth=%d,comments=%g,identifiers=%g,seed=%u",
+             sizeLabel(options.targetBytes).c_str(), options.maxDepth,
+             options.commentDensity, options.identifierRatio, options.seed);
+    result.name = name;
+
+    string source = generateQuetzalSource(options);
+    result.bytes = source.size();
+
+    // Small inputs are repeated until roughly 64 MB went through; the
+    // fastest repetition is reported, which is the most stable figure
+    const size_t repeats = clamp<size_t>((64u << 20) / max<size_t>(source.size(), 1), 1, 1000);
+    result.lexSeconds = result.parseSeconds = result.streamSeconds = 1e300;
+
+    for (size_t r = 0; r < repeats; r++) {
+        TokenBuffer tokens;
+        size_t before = allocationCount;
+        result.lexSeconds = min(result.lexSeconds, secondsFor([&] {
+            // Interning is part of lexing, as in the driver
+            Interner symbols;
+            Lexer lexer(source);
+            lexer.useInterner(symbols);
+            lexer.tokenize(tokens);
+        }));
+        size_t lexAllocations = allocationCount - before;
+        result.tokens = tokens.size();
+
+        before = allocationCount;
+        result.parseSeconds = min(result.parseSeconds, secondsFor([&] {
+            Parser parser(std::move(tokens), source);
+            Ast ast = parser.parse();
+        }));
+        size_t parseAllocations = allocationCount - before;
+
+        result.streamSeconds = min(result.streamSeconds, secondsFor([&] {
+            Interner symbols;
+            Lexer lexer(source);
+            lexer.useInterner(symbols);
+            Parser parser(lexer);
+            Ast ast = parser.parse();
+        }));
+
+        result.lexAllocsPerToken = static_cast<double>(lexAllocations) / result.tokens;
+        result.parseAllocsPerToken = static_cast<double>(parseAllocations) / result.tokens;
+    }
+    return result;
+}
+
+static void printJson(const CaseResult& result) {
+    printf("{\"case\":\"%s\",\"bytes\":%zu,\"tokens\":%zu,\"lexMBps\":%.2f,\"parseTokensPerSecond\":%.0f,"
+           "\"streamMBps\":%.2f,\"lexAllocsPerToken\":%.4f,\"parseAllocsPerToken\":%.4f}\n",
+           result.name.c_str(), result.bytes, result.tokens, result.lexMBps(),
+           result.parseTokensPerSecond(), result.streamMBps(),
+           result.lexAllocsPerToken, result.parseAllocsPerToken);
+}
+
+static void printRow(const CaseResult& result) {
+    printf("%-52s %10zu %9.1f %12.0f %9.1f %8.4f %8.4f\n", result.name.c_str(), result.tokens,
+           result.lexMBps(), result.parseTokensPerSecond(), result.streamMBps(),
+           result.lexAllocsPerToken, result.parseAllocsPerToken);
+}
+
+// Reads a numeric field from one line of --json output
+static double jsonNumber(const string& line, const string& field) {
+    size_t at = line.find("\"" + field + "\":");
+    return at == string::npos ? 0 : strtod(line.c_str() + at + field.size() + 3, nullptr);
+}
+
+static string jsonCase(const string& line) {
+    size_t at = line.find("\"case\":\"");
+    if (at == string::npos) return {};
+    at += 8;
+    return line.substr(at, line.find('"', at) - at);
+}
+
+int main(int argc, char* argv[]) {
+    GeneratorOptions base;
+    vector<size_t> sizes;
+    bool json = false;
+    string baselinePath, emitPath;
+    double tolerance = 0.10;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "%s expects a value\n", arg.c_str());
+                exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--size") sizes.push_back(parseSize(value()));
+        else if (arg == "--seed") base.seed = static_cast<uint32_t>(stoul(value()));
+        else if (arg == "--depth") base.maxDepth = stoi(value());
+        else if (arg == "--comments") base.commentDensity = stod(value());
+        else if (arg == "--identifiers") base.identifierRatio = stod(value());
+        else if (arg == "--json") json = true;
+        else if (arg == "--baseline") baselinePath = value();
+        else if (arg == "--tolerance") tolerance = stod(value());
+        else if (arg == "--emit") emitPath = value();
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    if (sizes.empty()) sizes = {1 << 10, 64 << 10, 1 << 20, 16 << 20};
+
+    if (!emitPath.empty()) {
+        GeneratorOptions options = base;
+        options.targetBytes = sizes.front();
+        ofstream out(emitPath, ios::binary);
+        out << generateQuetzalSource(options);
+        return out ? 0 : 2;
+    }
+
+    map<string, pair<double, double>> baseline;  // case -> (lexMBps, parseTokensPerSecond)
+    if (!baselinePath.empty()) {
+        ifstream in(baselinePath);
+        if (!in) {
+            fprintf(stderr, "Cannot read baseline %s\n", baselinePath.c_str());
+            return 2;
+        }
+        for (string line; getline(in, line);) {
+            string name = jsonCase(line);
+            if (!name.empty()) {
+                baseline[name] = {jsonNumber(line, "lexMBps"), jsonNumber(line, "parseTokensPerSecond")};
+            }
+        }
+    }
+
+    if (!json) {
+        printf("%-52s %10s %9s %12s %9s %8s %8s\n", "case", "tokens", "lex MB/s",
+               "parse tok/s", "pipe MB/s", "lex a/t", "parse a/t");
+    }
+
+    bool regressed = false;
+    for (size_t size : sizes) {
+        GeneratorOptions options = base;
+        options.targetBytes = size;
+        CaseResult result = runCase(options);
+        json ? printJson(result) : printRow(result);
+
+        auto it = baseline.find(result.name);
+        if (it == baseline.end()) continue;
+        auto [lexMBps, parseTokensPerSecond] = it->second;
+        if (result.lexMBps() < lexMBps * (1 - tolerance) ||
+            result.parseTokensPerSecond() < parseTokensPerSecond * (1 - tolerance)) {
+            fprintf(stderr, "REGRESSION %s: lex %.1f MB/s (baseline %.1f), parse %.0f tok/s (baseline %.0f)\n",
+                    result.name.c_str(), result.lexMBps(), lexMBps,
+                    result.parseTokensPerSecond(), parseTokensPerSecond);
+            regressed = true;
+        }
+    }
+    return regressed ? 1 : 0;
+}
@@ -0,0 +1,381 @@
+#include "SourceGenerator.h"
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const char* const WORDS[] = {
+    "sum", "first", "result", "remainder", "count", "value", "total", "index",
+    "number", "limit", "digit", "carry", "left", "right", "middle", "day",
+    "month", "year", "temp", "flag", "accumulator", "number_of_items"
+};
+const char* const STRINGS[] = {
+    "\"Hello, World!\"", "\"error in short circuit operator\"", "\", \"",
+    "\"Enter a number: \"", "\"Tab\\tseparated\\n\"", "\"Quote: \\\"q\\\"\"",
+    "\"Unicode: \\u0000C1\\u0000F1\"", "\"Backslash \\\\ done\""
+};
+const char* const CHARS[] = {
+    "'a'", "'Z'", "'0'", "' '", "'['", "']'", "'\\n'", "'\\t'", "'\\''", "'\\\\'", "'\\u000041'"
+};
+const char* const COMMENTS[] = {
+    "Returns the addition of all elements.", "Checks the boundary condition first.",
+    "Bubble sort, swapping adjacent elements.", "THIS BLOCK IS INTENTIONALLY VERBOSE",
+    "Counter guarded loop.", "TODO: handle negative numbers."
+};
+
+template <size_t N>
+const char* pickFrom(mt19937& random, const char* const (&items)[N]) {
+    return items[uniform_int_distribution<size_t>(0, N - 1)(random)];
+}
+
+class Generator {
+private:
+    const GeneratorOptions& options;
+    mt19937 random;
+    string out;
+
+    struct Function {
+        string name;
+        int arity;
+    };
+    vector<Function> functions;
+    vector<Function> leaves;      // Functions without calls, the only call targets
+    vector<string> globals;
+
+    // Current function
+    vector<string> ints;          // Parameters, int locals and globals
+    vector<string> arrays;        // Locals holding array handles
+    bool arraysReady = false;     // Arrays are only used once initialised
+    int indentLevel = 0;
+
+    bool chance(double probability) {
+        return uniform_real_distribution<double>(0, 1)(random) < probability;
+    }
+    int between(int low, int high) {
+        return uniform_int_distribution<int>(low, high)(random);
+    }
+    template <typename T>
+    const T& pick(const vector<T>& items) {
+        return items[uniform_int_distribution<size_t>(0, items.size() - 1)(random)];
+    }
+
+    void indent() { out.append(indentLevel * 4, ' '); }
+
+    void comment() {
+        indent();
+        if (chance(0.2)) {
+            out += "/* ";
+            out += pickFrom(random, COMMENTS);
+            out += "\n";
+            indent();
+            out += "   ";
+            out += pickFrom(random, COMMENTS);
+            out += " */\n";
+        } else {
+            out += "// ";
+            out += pickFrom(random, COMMENTS);
+            out += '\n';
+        }
+    }
+
+    void literal() {
+        switch (between(0, 5)) {
+            case 0: out += pickFrom(random, CHARS); break;
+            case 1: out += chance(0.5) ? "true" : "false"; break;
+            default: out += to_string(between(0, 1000)); break;
+        }
+    }
+
+    void leaf() {
+        if (chance(options.identifierRatio)) {
+            out += pick(ints);
+        } else {
+            literal();
+        }
+    }
+
+    void call(const Function& callee, int depth) {
+        out += callee.name;
+        out += '(';
+        for (int i = 0; i < callee.arity; i++) {
+            if (i > 0) out += ", ";
+            expression(depth + 1);
+        }
+        out += ')';
+    }
+
+    void expression(int depth, bool allowCalls = true) {
+        if (depth >= 3 || chance(0.35)) {
+            leaf();
+            return;
+        }
+        switch (between(0, 9)) {
+            case 0:
+                out += '(';
+                expression(depth + 1, allowCalls);
+                out += ')';
+                break;
+            case 1:
+                out += chance(0.5) ? "not " : "-";
+                out += '(';
+                expression(depth + 1, allowCalls);
+                out += ')';
+                break;
+            case 2:
+                // Divisors are literals, never zero
+                expression(depth + 1, allowCalls);
+                out += chance(0.5) ? " / " : " % ";
+                out += to_string(between(1, 16));
+                break;
+            case 3:
+                if (allowCalls && !leaves.empty()) {
+                    call(pick(leaves), depth);
+                } else {
+                    leaf();
+                }
+                break;
+            case 4:
+                if (!arraysReady) {
+                    leaf();
+                } else if (chance(0.5)) {
+                    out += "size(" + pick(arrays) + ")";
+                } else {
+                    out += "get(" + pick(arrays) + ", 0)";
+                }
+                break;
+            default: {
+                static const char* const OPERATORS[] = {
+                    " + ", " - ", " * ", " == ", " != ", " < ", " <= ", " > ", " >= ", " and ", " or "
+                };
+                expression(depth + 1, allowCalls);
+                out += pickFrom(random, OPERATORS);
+                expression(depth + 1, allowCalls);
+                break;
+            }
+        }
+    }
+
+    void block(int depth, bool allowCalls) {
+        out += "{\n";
+        indentLevel++;
+        int statements = between(1, 4);
+        for (int i = 0; i < statements; i++) {
+            statement(depth, allowCalls);
+        }
+        indentLevel--;
+        indent();
+        out += '}';
+    }
+
+    void statement(int depth, bool allowCalls) {
+        if (chance(options.commentDensity)) comment();
+        indent();
+
+        int choice = between(0, 11);
+        if (depth >= options.maxDepth && choice >= 10) choice = between(0, 9);
+        switch (choice) {
+            case 0: case 1: case 2:
+                out += pick(ints);
+                out += " = ";
+                expression(0, allowCalls);
+                out += ";\n";
+                break;
+            case 3:
+                out += chance(0.5) ? "inc " : "dec ";
+                out += pick(ints);
+                out += ";\n";
+                break;
+            case 4:
+                out += "printi(";
+                expression(0, allowCalls);
+                out += ");\n";
+                break;
+            case 5:
+                out += "printc(";
+                out += pickFrom(random, CHARS);
+                out += ");\n";
+                break;
+            case 6:
+                out += "prints(";
+                out += pickFrom(random, STRINGS);
+                out += ");\n";
+                break;
+            case 7:
+                out += "println();\n";
+                break;
+            case 8:
+                // Index 0 always exists: arrays start non-empty and only grow
+                if (chance(0.5)) {
+                    out += "add(";
+                    out += pick(arrays);
+                    out += ", ";
+                } else {
+                    out += "set(";
+                    out += pick(arrays);
+                    out += ", 0, ";
+                }
+                expression(0, allowCalls);
+                out += ");\n";
+                break;
+            case 9:
+                // A call statement, or the empty statement in leaves
+                if (allowCalls && !leaves.empty()) call(pick(leaves), 0);
+                out += ";\n";
+                break;
+            case 10: {
+                out += "if (";
+                expression(0, allowCalls);
+                out += ") ";
+                block(depth + 1, allowCalls);
+                int elifs = between(0, 2);
+                for (int i = 0; i < elifs; i++) {
+                    out += " elif (";
+                    expression(0, allowCalls);
+                    out += ") ";
+                    block(depth + 1, allowCalls);
+                }
+                if (chance(0.5)) {
+                    out += " else ";
+                    block(depth + 1, allowCalls);
+                }
+                out += '\n';
+                break;
+            }
+            case 11: {
+                // Each nesting level owns a counter that the body never assigns
+                string counter = "c" + to_string(depth);
+                out += counter + " = 0;\n";
+                indent();
+                out += "loop {\n";
+                indentLevel++;
+                indent();
+                out += "if (" + counter + " >= " + to_string(between(1, 8)) + ") {\n";
+                indent();
+                out += "    break;\n";
+                indent();
+                out += "}\n";
+                int statements = between(1, 4);
+                for (int i = 0; i < statements; i++) {
+                    statement(depth + 1, allowCalls);
+                }
+                indent();
+                out += "inc " + counter + ";\n";
+                indentLevel--;
+                indent();
+                out += "}\n";
+                break;
+            }
+        }
+    }
+
+    void function(size_t index) {
+        // Every fourth function is a leaf that others may call; callers only
+        // reach leaves, which keeps the run time of the program bounded
+        bool isLeaf = index % 4 == 0;
+        Function current{string(pickFrom(random, WORDS)) + "_" + to_string(index), between(0, 3)};
+
+        ints = globals;
+        arrays.clear();
+        if (chance(options.commentDensity * 4)) comment();
+        out += current.name + "(";
+        for (int i = 0; i < current.arity; i++) {
+            string param = "p" + to_string(i);
+            if (i > 0) out += ", ";
+            out += param;
+            ints.push_back(param);
+        }
+        out += ") {\n";
+        indentLevel = 1;
+
+        // Locals: ints, one or two arrays and one loop counter per level
+        vector<string> locals;
+        int intCount = between(1, 4);
+        for (int i = 0; i < intCount; i++) {
+            locals.push_back(string(pickFrom(random, WORDS)) + to_string(i));
+            ints.push_back(locals.back());
+        }
+        int arrayCount = between(1, 2);
+        for (int i = 0; i < arrayCount; i++) {
+            locals.push_back("array" + to_string(i));
+            arrays.push_back(locals.back());
+        }
+        for (int i = 0; i < options.maxDepth; i++) {
+            locals.push_back("c" + to_string(i));
+        }
+        indent();
+        out += "var ";
+        for (size_t i = 0; i < locals.size(); i++) {
+            if (i > 0) out += ", ";
+            out += locals[i];
+        }
+        out += ";\n";
+
+        arraysReady = false;
+        for (const auto& array : arrays) {
+            indent();
+            out += array + " = [";
+            int elements = between(1, 5);
+            for (int i = 0; i < elements; i++) {
+                if (i > 0) out += ", ";
+                expression(1, !isLeaf);
+            }
+            out += "];\n";
+        }
+        arraysReady = true;
+
+        int statements = between(3, 8);
+        for (int i = 0; i < statements; i++) {
+            statement(0, !isLeaf);
+        }
+        indent();
+        out += "return ";
+        expression(0, !isLeaf);
+        out += ";\n}\n\n";
+        indentLevel = 0;
+
+        functions.push_back(current);
+        if (isLeaf) leaves.push_back(current);
+    }
+
+public:
+    Generator(const GeneratorOptions& options) : options(options), random(options.seed) {}
+
+    string run() {
+        out.reserve(options.targetBytes + 4096);
+        out += "/* Synthetic Quetzal program, seed " + to_string(options.seed) + " */\n\n";
+
+        int globalCount = between(1, 4);
+        out += "var ";
+        for (int i = 0; i < globalCount; i++) {
+            globals.push_back("g" + to_string(i));
+            if (i > 0) out += ", ";
+            out += globals.back();
+        }
+        out += ";\n\n";
+
+        size_t index = 0;
+        do {
+            function(index++);
+        } while (out.size() < options.targetBytes);
+
+        out += "main() {\n";
+        for (const auto& function : functions) {
+            out += "    printi(" + function.name + "(";
+            for (int i = 0; i < function.arity; i++) {
+                out += i > 0 ? ", " : "";
+                out += to_string(i + 1);
+            }
+            out += "));\n    println();\n";
+        }
+        out += "}\n";
+        return std::move(out);
+    }
+};
+
+}
+
+string generateQuetzalSource(const GeneratorOptions& options) {
+    return Generator(options).run();
+}
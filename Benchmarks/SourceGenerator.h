@@ -0,0 +1,23 @@
+#ifndef TC3002_COMPILER_SOURCEGENERATOR_H
+#define TC3002_COMPILER_SOURCEGENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+// Shape of a synthetic Quetzal program
+struct GeneratorOptions {
+    size_t targetBytes = 1024 * 1024;  // Output stops at the first function boundary past this
+    uint32_t seed = 1;
+    int maxDepth = 4;                  // Nesting of if/elif/else and loop blocks
+    double commentDensity = 0.1;       // Chance of a comment before each statement
+    double identifierRatio = 0.6;      // Share of expression leaves that are variables
+};
+
+// Produces a valid program built from the constructs in QuetzalCodeExamples/:
+// globals, functions with parameters, var lists, loops guarded by counters,
+// if/elif/else chains, inc/dec, array literals and every API function. Only
+// earlier functions are called and divisors are non-zero literals, so the
+// output also terminates when run. The same options give the same source.
+std::string generateQuetzalSource(const GeneratorOptions& options);
+
+#endif //TC3002_COMPILER_SOURCEGENERATOR_H
@@ -0,0 +1,193 @@
+// Interpreter throughput on small compute kernels.
+//
+//   VMBench [--scale F] [--json] [-O0]
+//
+// Each kernel is compiled once and run a few times; the fastest run is
+// reported as seconds and bytecode instructions per second, along with the
+// array collections of that run and their total pause. --scale
+// multiplies every kernel's problem size (default 1); -O0 skips the
+// optimiser, as in the driver.
+
+#include "../Util/Bytecode/BytecodeCompiler.h"
+#include "../Util/Interner/Interner.h"
+#include "../Util/Lexer/Lexer.h"
+#include "../Util/Optimizer/Optimizer.h"
+#include "../Util/Parser/Parser.h"
+#include "../Util/Semantic/SemanticAnalyzer.h"
+#include "../Util/VM/VM.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct Kernel {
+    const char* name;
+    const char* source;  // "N" is replaced by the problem size
+    int size;
+};
+
+static const Kernel KERNELS[] = {
+    {"loop", R"(
+        main() {
+            var i, sum;
+            i = 0;
+            sum = 0;
+            loop {
+                if (i >= N) { break; }
+                sum = sum + i * 3 % 7;
+                inc i;
+            }
+            printi(sum);
+        }
+    )", 20000000},
+    {"fib", R"(
+        fib(n) {
+            if (n < 2) { return n; }
+            return fib(n - 1) + fib(n - 2);
+        }
+        main() { printi(fib(N)); }
+    )", 30},
+    {"bubble_sort", R"(
+        main() {
+            var a, i, j, n, x, y, seed;
+            a = new(0);
+            seed = 12345;
+            i = 0;
+            loop {
+                if (i >= N) { break; }
+                seed = (seed * 1103515245 + 12345) % 65536;
+                add(a, seed);
+                inc i;
+            }
+            n = size(a);
+            i = 0;
+            loop {
+                if (i >= n - 1) { break; }
+                j = 0;
+                loop {
+                    if (j >= n - i - 1) { break; }
+                    x = get(a, j);
+                    y = get(a, j + 1);
+                    if (x > y) {
+                        set(a, j, y);
+                        set(a, j + 1, x);
+                    }
+                    inc j;
+                }
+                inc i;
+            }
+            printi(get(a, 0));
+        }
+    )", 3000},
+    {"sieve", R"(
+        main() {
+            var flags, i, j, count;
+            flags = new(N + 1);
+            count = 0;
+            i = 2;
+            loop {
+                if (i > N) { break; }
+                if (not get(flags, i)) {
+                    inc count;
+                    j = i + i;
+                    loop {
+                        if (j > N) { break; }
+                        set(flags, j, 1);
+                        j = j + i;
+                    }
+                }
+                inc i;
+            }
+            printi(count);
+        }
+    )", 5000000},
+    {"small_arrays", R"(
+        main() {
+            var i, p, sum;
+            i = 0;
+            sum = 0;
+            loop {
+                if (i >= N) { break; }
+                p = new(2);
+                set(p, 0, i);
+                set(p, 1, i % 7);
+                add(p, 3);
+                sum = sum + get(p, 0) + get(p, 1) + get(p, 2);
+                inc i;
+            }
+            printi(sum);
+        }
+    )", 1000000},
+};
+
+static BytecodeProgram compileKernel(const string& source, bool optimize) {
+    Interner symbols;
+    Lexer lexer(source);
+    lexer.useInterner(symbols);
+    Parser parser(lexer);
+    Ast ast = parser.parse();
+    vector<string> diagnostics;
+    ProgramInfo info = SemanticAnalyzer(ast, source, symbols).analyze(diagnostics);
+    if (!diagnostics.empty()) throw runtime_error(diagnostics.front());
+    if (optimize) Optimizer(ast, info).optimize();
+    return BytecodeCompiler(ast, source, info).compile();
+}
+
+int main(int argc, char* argv[]) {
+    double scale = 1;
+    bool json = false;
+    bool optimize = true;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--scale" && i + 1 < argc) scale = stod(argv[++i]);
+        else if (arg == "--json") json = true;
+        else if (arg == "-O0") optimize = false;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    if (!json) {
+        printf("%-12s %12s %14s %10s %12s %6s %10s\n", "kernel", "size", "instructions", "seconds", "MIPS", "gcs",
+               "gc pause");
+    }
+    for (const Kernel& kernel : KERNELS) {
+        // fib grows exponentially, so its size scales by steps instead
+        int size = kernel.name == string("fib") ? kernel.size + static_cast<int>(scale) - 1
+                                                : max(1, static_cast<int>(kernel.size * scale));
+        string source = kernel.source;
+        for (size_t at; (at = source.find('N')) != string::npos;) source.replace(at, 1, to_string(size));
+        BytecodeProgram program = compileKernel(source, optimize);
+
+        double best = 1e300;
+        uint64_t instructions = 0;
+        ArrayStore::Statistics gc;
+        for (int r = 0; r < 3; r++) {
+            BufferedWriter out;  // Kernels print one number; it is not shown
+            VM vm(program, out);
+            auto start = chrono::steady_clock::now();
+            vm.run();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (seconds < best) gc = vm.arrayStore().statistics();
+            best = min(best, seconds);
+            instructions = vm.instructionsExecuted();
+        }
+
+        double mips = instructions / best / 1e6;
+        if (json) {
+            printf("{\"kernel\":\"%s\",\"size\":%d,\"instructions\":%llu,\"seconds\":%.4f,\"mips\":%.1f,"
+                   "\"collections\":%llu,\"pauseSeconds\":%.4f}\n",
+                   kernel.name, size, static_cast<unsigned long long>(instructions), best, mips,
+                   static_cast<unsigned long long>(gc.collections), gc.pauseSeconds);
+        } else {
+            printf("%-12s %12d %14llu %10.4f %12.1f %6llu %10.4f\n", kernel.name, size,
+                   static_cast<unsigned long long>(instructions), best, mips,
+                   static_cast<unsigned long long>(gc.collections), gc.pauseSeconds);
+        }
+    }
+    return 0;
+}
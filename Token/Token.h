@@ -2,12 +2,24 @@
 #define TOKEN_H
 
 #include "../TokenKind/TokenKind.h"
+#include <cstdint>
 #include <string>
+#include <string_view>
 using namespace std;
+
+// A token is a view into the source the Lexer keeps alive: it records the
+// (offset, length) span of its lexeme instead of owning a copy of it.
 struct Token {
     TokenKind kind;
-    std::string value;
+    uint32_t offset;   // Byte offset of the lexeme in the source
+    uint32_t length;   // Lexeme length in bytes
     size_t line;
     size_t column;
+    int64_t intValue;  // Checked value of LIT_INT tokens, symbol ID of IDENTIFIER
+                       // and MAIN tokens when the lexer interns, 0 otherwise
 };
-#endif // TOKEN_H
\ No newline at end of file
+
+inline string_view tokenText(const Token& token, string_view source) {
+    return source.substr(token.offset, token.length);
+}
+#endif // TOKEN_H
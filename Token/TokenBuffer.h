@@ -0,0 +1,56 @@
+#ifndef TC3002_COMPILER_TOKENBUFFER_H
+#define TC3002_COMPILER_TOKENBUFFER_H
+
+#include "Token.h"
+#include <cstdint>
+#include <vector>
+
+struct TokenSpan {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct TokenLocation {
+    uint32_t line;
+    uint32_t column;
+};
+
+// Structure-of-arrays token storage. Lookahead only ever reads the dense
+// one-byte kinds array; spans, locations and literal values are touched
+// when a token is actually consumed.
+struct TokenBuffer {
+    std::vector<TokenKind> kinds;
+    std::vector<TokenSpan> spans;
+    std::vector<TokenLocation> locations;
+    std::vector<int64_t> values;  // LIT_INT values and IDENTIFIER symbol IDs, 0 for other kinds
+
+    size_t size() const { return kinds.size(); }
+
+    void push(const Token& token) {
+        kinds.push_back(token.kind);
+        spans.push_back({token.offset, token.length});
+        locations.push_back({static_cast<uint32_t>(token.line), static_cast<uint32_t>(token.column)});
+        values.push_back(token.intValue);
+    }
+
+    Token at(size_t index) const {
+        return {kinds[index], spans[index].offset, spans[index].length,
+                locations[index].line, locations[index].column, values[index]};
+    }
+
+    void reserve(size_t count) {
+        kinds.reserve(count);
+        spans.reserve(count);
+        locations.reserve(count);
+        values.reserve(count);
+    }
+
+    void clear() {
+        kinds.clear();
+        spans.clear();
+        locations.clear();
+        values.clear();
+    }
+};
+
+#endif //TC3002_COMPILER_TOKENBUFFER_H
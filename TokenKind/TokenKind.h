@@ -6,10 +6,11 @@
 #define TC3002_COMPILER_TOKENKIND_H
 
 
+#include <cstdint>
 #include <string>
 #include <unordered_set>
 using namespace std;
-enum class TokenKind {
+enum class TokenKind : uint8_t {
     // Keywords
     AND, BREAK, DEC, ELIF, ELSE, FALSE, IF, INC, LOOP, NOT, OR,
     RETURN, TRUE, VAR,
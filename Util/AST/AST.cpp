@@ -0,0 +1,166 @@
+#include "AST.h"
+#include "../Lexer/Lexer.h"
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+NodeId Ast::addNode(NodeKind kind, uint32_t ref, const NodeId* children, uint32_t count,
+                    int32_t value, TokenKind op) {
+    auto first = static_cast<uint32_t>(childIds.size());
+    childIds.insert(childIds.end(), children, children + count);
+    nodes.push_back({kind, op, 0, ref, first, count, value});
+    return static_cast<NodeId>(nodes.size() - 1);
+}
+
+uint32_t Ast::addRef(const Token& token) {
+    refs.push_back({token.offset, token.length,
+                    static_cast<uint32_t>(token.line), static_cast<uint32_t>(token.column)});
+    return static_cast<uint32_t>(refs.size() - 1);
+}
+
+uint32_t Ast::addRef(const SourceRef& ref) {
+    refs.push_back(ref);
+    return static_cast<uint32_t>(refs.size() - 1);
+}
+
+void Ast::popNode() {
+    nodes.pop_back();
+}
+
+void Ast::replaceChildren(NodeId id, const NodeId* children, uint32_t count) {
+    Node& n = nodes[id];
+    if (count <= n.count) {
+        // Forward copy, safe when the new list is a later part of the old one
+        copy(children, children + count, childIds.begin() + n.first);
+    } else {
+        n.first = static_cast<uint32_t>(childIds.size());
+        childIds.insert(childIds.end(), children, children + count);
+    }
+    n.count = count;
+}
+
+string_view Ast::text(NodeId id, string_view source) const {
+    const Node& n = nodes[id];
+    if (n.ref == NO_REF) return {};
+    return source.substr(refs[n.ref].offset, refs[n.ref].length);
+}
+
+void Ast::reserve(size_t nodeCount) {
+    nodes.reserve(nodeCount);
+    childIds.reserve(nodeCount);
+    refs.reserve(nodeCount);
+}
+
+void Ast::reset() {
+    // Keeps the capacity, so the next parse reuses the same memory
+    nodes.clear();
+    childIds.clear();
+    refs.clear();
+    root = NO_NODE;
+}
+
+void Ast::makeRelative(uint32_t baseOffset, uint32_t baseLine) {
+    for (auto& ref : refs) {
+        ref.offset -= baseOffset;
+        ref.line -= baseLine;
+    }
+}
+
+NodeId Ast::graft(const Ast& from, NodeId id, uint32_t baseOffset, uint32_t baseLine) {
+    // Post-order with an explicit stack: children are copied before their
+    // parent, whose child list then points at the copies
+    struct Frame {
+        NodeId source;
+        size_t mark;        // Start of this node's copied children in `copied`
+        uint32_t next = 0;  // Next child to visit
+    };
+    vector<NodeId> copied;
+    vector<Frame> stack = {{id, 0}};
+    while (true) {
+        Frame& frame = stack.back();
+        const Node& n = from.nodes[frame.source];
+        if (frame.next < n.count) {
+            NodeId child = from.childIds[n.first + frame.next++];
+            stack.push_back({child, copied.size()});
+            continue;
+        }
+
+        uint32_t ref = NO_REF;
+        if (n.ref != NO_REF) {
+            SourceRef source = from.refs[n.ref];
+            source.offset += baseOffset;
+            source.line += baseLine;
+            ref = addRef(source);
+        }
+        NodeId copy = addNode(n.kind, ref, copied.data() + frame.mark, n.count, n.value, n.op);
+        nodes[copy].flags = n.flags;
+        copied.resize(frame.mark);
+        stack.pop_back();
+        if (stack.empty()) return copy;
+        copied.push_back(copy);
+    }
+}
+
+const char* Ast::kindName(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Program: return "Program";
+        case NodeKind::Function: return "Function";
+        case NodeKind::Param: return "Param";
+        case NodeKind::VarDecl: return "VarDecl";
+        case NodeKind::Declarator: return "Declarator";
+        case NodeKind::Block: return "Block";
+        case NodeKind::If: return "If";
+        case NodeKind::Loop: return "Loop";
+        case NodeKind::Break: return "Break";
+        case NodeKind::Return: return "Return";
+        case NodeKind::Inc: return "Inc";
+        case NodeKind::Dec: return "Dec";
+        case NodeKind::ExprStmt: return "ExprStmt";
+        case NodeKind::Empty: return "Empty";
+        case NodeKind::Error: return "Error";
+        case NodeKind::Assign: return "Assign";
+        case NodeKind::Binary: return "Binary";
+        case NodeKind::Unary: return "Unary";
+        case NodeKind::Call: return "Call";
+        case NodeKind::ApiCall: return "ApiCall";
+        case NodeKind::Identifier: return "Identifier";
+        case NodeKind::IntLiteral: return "IntLiteral";
+        case NodeKind::CharLiteral: return "CharLiteral";
+        case NodeKind::BoolLiteral: return "BoolLiteral";
+        case NodeKind::StringLiteral: return "StringLiteral";
+        case NodeKind::ArrayLiteral: return "ArrayLiteral";
+    }
+    return "Unknown";
+}
+
+void Ast::dump(BufferedWriter& out, string_view source) const {
+    if (root == NO_NODE) return;
+
+    // Explicit stack of (node, depth), so deep trees cannot overflow the call stack
+    vector<pair<NodeId, size_t>> stack = {{root, 0}};
+    while (!stack.empty()) {
+        auto [id, depth] = stack.back();
+        stack.pop_back();
+        const Node& n = nodes[id];
+
+        for (size_t i = 0; i < depth; i++) out << "  ";
+        out << kindName(n.kind);
+        if (n.op != TokenKind::UNKNOWN) out << ' ' << Lexer::tokenKindToString(n.op);
+        if (n.ref != NO_REF) out << " '" << text(id, source) << "'";
+        switch (n.kind) {
+            case NodeKind::IntLiteral:
+            case NodeKind::CharLiteral:
+            case NodeKind::BoolLiteral:
+                out << " = " << n.value;
+                break;
+            default:
+                break;
+        }
+        out << '\n';
+
+        for (uint32_t i = n.count; i > 0; i--) {
+            stack.push_back({childIds[n.first + i - 1], depth + 1});
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef TC3002_COMPILER_AST_H
+#define TC3002_COMPILER_AST_H
+
+#include "../../Token/Token.h"
+#include "../Output/BufferedWriter.h"
+#include "../Interner/Interner.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Index-based syntax tree. Nodes, child lists and source references live in
+// three flat arrays that act as arenas: nodes refer to each other through
+// 32-bit indices, the children of a node are stored contiguously, and the
+// whole tree is released with a single reset(). Named nodes (Function, Param,
+// Declarator, Inc, Dec, Assign, Call, Identifier) keep the name's symbol ID in
+// their value.
+
+using NodeId = uint32_t;
+constexpr NodeId NO_NODE = UINT32_MAX;
+constexpr uint32_t NO_REF = UINT32_MAX;
+
+enum class NodeKind : uint8_t {
+    // Declarations
+    Program,        // children: VarDecl | Function
+    Function,       // ref: name, children: Param* Block
+    Param,          // ref: name
+    VarDecl,        // children: Declarator+
+    Declarator,     // ref: name, children: [initializer]
+
+    // Statements
+    Block,          // children: statements
+    If,             // children: (condition, body)+ [else body]
+    Loop,           // children: [condition] body
+    Break,
+    Return,         // children: [value]
+    Inc,            // ref: variable
+    Dec,            // ref: variable
+    ExprStmt,       // children: expression
+    Empty,          // A lone ';'
+    Error,          // Placeholder for a construct that failed to parse
+
+    // Expressions
+    Assign,         // ref: variable, children: value
+    Binary,         // op: operator (AND/OR included), children: left right
+    Unary,          // op: PLUS | MINUS | NOT, children: operand
+    Call,           // ref: function name, children: arguments
+    ApiCall,        // op: API function, children: arguments
+    Identifier,     // ref: variable
+    IntLiteral,     // value
+    CharLiteral,    // value: code point
+    BoolLiteral,    // value: 0 or 1
+    StringLiteral,  // ref: lexeme, decoded on demand
+    ArrayLiteral,   // children: elements
+};
+
+// Location of a token that a node refers to (names, literals, operators)
+struct SourceRef {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t line;
+    uint32_t column;
+};
+
+struct Node {
+    NodeKind kind;
+    TokenKind op;       // Operator or API function, UNKNOWN otherwise
+    uint16_t flags;     // Set by later passes, see below
+    uint32_t ref;       // SourceRef index or NO_REF
+    uint32_t first;     // First child in the child array
+    uint32_t count;     // Number of children
+    int32_t value;      // Literal value or symbol ID
+};
+
+// Node flags
+constexpr uint16_t IN_BOUNDS = 1;  // get/set whose handle and index the optimiser proved valid
+
+class Ast {
+private:
+    std::vector<Node> nodes;
+    std::vector<NodeId> childIds;
+    std::vector<SourceRef> refs;
+
+public:
+    NodeId root = NO_NODE;
+
+    NodeId addNode(NodeKind kind, uint32_t ref, const NodeId* children, uint32_t count,
+                   int32_t value = 0, TokenKind op = TokenKind::UNKNOWN);
+    uint32_t addRef(const Token& token);
+    uint32_t addRef(const SourceRef& ref);
+    // Drops the most recently added node, which must have no children
+    void popNode();
+    // Gives a node a new child list, for passes that rewrite the tree in
+    // place. A list no longer than the old one is written over it; `children`
+    // may point into the old list only in that case.
+    void replaceChildren(NodeId id, const NodeId* children, uint32_t count);
+
+    const Node& node(NodeId id) const { return nodes[id]; }
+    Node& node(NodeId id) { return nodes[id]; }
+    const NodeId* children(NodeId id) const { return childIds.data() + nodes[id].first; }
+    NodeId child(NodeId id, uint32_t index) const { return childIds[nodes[id].first + index]; }
+    const SourceRef& refOf(NodeId id) const { return refs[nodes[id].ref]; }
+    SymbolId symbol(NodeId id) const { return static_cast<SymbolId>(nodes[id].value); }
+    std::string_view text(NodeId id, std::string_view source) const;
+
+    size_t size() const { return nodes.size(); }
+    void reserve(size_t nodeCount);
+    void reset();
+
+    // Makes every source reference relative to a base position, so a tree can
+    // be kept while the text before it changes (see IncrementalParser)
+    void makeRelative(uint32_t baseOffset, uint32_t baseLine);
+    // Copies the subtree at `id` of another tree, whose references are
+    // relative to the given base, and returns its id in this tree
+    NodeId graft(const Ast& from, NodeId id, uint32_t baseOffset, uint32_t baseLine);
+
+    // Indented tree listing, mainly for debugging
+    void dump(BufferedWriter& out, std::string_view source) const;
+
+    static const char* kindName(NodeKind kind);
+};
+
+#endif //TC3002_COMPILER_AST_H
@@ -0,0 +1,68 @@
+#include "Bytecode.h"
+#include <string>
+
+using namespace std;
+
+static const char* const OPCODE_NAMES[] = {
+#define QUETZAL_OPCODE_NAME(name, operands) #name,
+    QUETZAL_OPCODES(QUETZAL_OPCODE_NAME)
+#undef QUETZAL_OPCODE_NAME
+};
+
+static const char* const OPCODE_OPERANDS[] = {
+#define QUETZAL_OPCODE_OPERANDS(name, operands) operands,
+    QUETZAL_OPCODES(QUETZAL_OPCODE_OPERANDS)
+#undef QUETZAL_OPCODE_OPERANDS
+};
+
+const char* BytecodeProgram::opcodeName(Opcode op) {
+    auto index = static_cast<size_t>(op);
+    return index < OPCODE_COUNT ? OPCODE_NAMES[index] : "???";
+}
+
+uint32_t BytecodeProgram::functionEnd(size_t function) const {
+    uint32_t entry = functions[function].entry;
+    uint32_t end = static_cast<uint32_t>(code.size());
+    for (const auto& other : functions) {
+        if (other.entry > entry && other.entry < end) end = other.entry;
+    }
+    return end;
+}
+
+void BytecodeProgram::disassemble(BufferedWriter& out) const {
+    for (size_t f = 0; f < functions.size(); f++) {
+        const BytecodeFunction& function = functions[f];
+        out << function.name << " (" << function.paramCount << " params, "
+            << function.registerCount << " registers)\n";
+
+        for (uint32_t pc = function.entry, end = functionEnd(f); pc < end; pc++) {
+            const Instruction& instruction = code[pc];
+            string_view name = opcodeName(instruction.op);
+            string index = to_string(pc);
+            out << "  ";
+            for (size_t i = index.size(); i < 5; i++) out << ' ';
+            out << index << "  " << name;
+
+            const char* separator = "";
+            for (const char* operand = OPCODE_OPERANDS[static_cast<size_t>(instruction.op)]; *operand; operand++) {
+                if (!*separator) {
+                    for (size_t i = name.size(); i < 8; i++) out << ' ';
+                    separator = " ";
+                }
+                out << separator;
+                separator = ", ";
+                switch (*operand) {
+                    case 'a': out << 'r' << instruction.a; break;
+                    case 'b': out << 'r' << instruction.b; break;
+                    case 'c': out << 'r' << instruction.c; break;
+                    case 'i': out << instruction.imm; break;
+                    case 't': out << '@' << instruction.imm; break;
+                    case 'g': out << 'g' << instruction.imm; break;
+                    case 's': out << 's' << instruction.imm; break;
+                    case 'f': out << functions[instruction.imm].name; break;
+                }
+            }
+            out << '\n';
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef TC3002_COMPILER_BYTECODE_H
+#define TC3002_COMPILER_BYTECODE_H
+
+#include "../Output/BufferedWriter.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Register bytecode. Every instruction is 8 bytes: an opcode, three 8-bit
+// register operands and a 32-bit immediate, so no instruction ever needs a
+// second word. Registers are frame-relative: a function's locals occupy
+// registers 0..frameSize-1 (parameters first) and temporaries follow.
+//
+// X(name, operands): the operand string drives the disassembler. a, b and c
+// are registers, i an immediate, t a jump target, f a function, g a global
+// and s a string constant.
+#define QUETZAL_OPCODES(X)                                                  \
+    X(MOV, "ab")      /* a = b */                                           \
+    X(LOADI, "ai")    /* a = imm */                                         \
+    X(GETG, "ag")     /* a = globals[imm] */                                \
+    X(SETG, "ag")     /* globals[imm] = a */                                \
+    X(ADD, "abc")     /* a = b + c, wrapping */                             \
+    X(SUB, "abc")                                                           \
+    X(MUL, "abc")                                                           \
+    X(DIV, "abc")     /* Truncates; division by zero is a runtime error */  \
+    X(MOD, "abc")                                                           \
+    X(ADDI, "abi")    /* a = b + imm */                                     \
+    X(NEG, "ab")                                                            \
+    X(NOT, "ab")      /* a = b == 0 */                                      \
+    X(BOOL, "ab")     /* a = b != 0 */                                      \
+    X(EQ, "abc")      /* a = b == c, likewise for the other comparisons */  \
+    X(NE, "abc")                                                            \
+    X(LT, "abc")                                                            \
+    X(LE, "abc")                                                            \
+    X(GT, "abc")                                                            \
+    X(GE, "abc")                                                            \
+    X(INC, "a")                                                             \
+    X(DEC, "a")                                                             \
+    X(JMP, "t")                                                             \
+    X(JZ, "at")                                                             \
+    X(JNZ, "at")                                                            \
+    X(JEQ, "abt")     /* Jump when a == b, likewise for the others */       \
+    X(JNE, "abt")                                                           \
+    X(JLT, "abt")                                                           \
+    X(JLE, "abt")                                                           \
+    X(JGT, "abt")                                                           \
+    X(JGE, "abt")                                                           \
+    X(CALL, "af")     /* Arguments in a.., the callee's frame starts at a */ \
+    X(RET, "a")       /* Result goes to the callee's register 0 */          \
+    X(RET0, "")                                                             \
+    X(PRINTI, "a")                                                          \
+    X(PRINTC, "a")                                                          \
+    X(PRINTS, "a")                                                          \
+    X(PRINTLN, "")                                                          \
+    X(READI, "a")                                                           \
+    X(READS, "a")                                                           \
+    X(NEW, "ab")      /* a = new(b) */                                      \
+    X(SIZE, "ab")     /* a = size(b) */                                     \
+    X(APPEND, "ab")   /* add(a, b) */                                       \
+    X(GET, "abc")     /* a = get(b, c) */                                   \
+    X(SET, "abc")     /* set(a, b, c) */                                    \
+    X(GETU, "abc")    /* a = get(b, c), proven in bounds: no checks */      \
+    X(SETU, "abc")    /* set(a, b, c), proven in bounds: no checks */       \
+    X(ARRAY, "ai")    /* a = new(imm), for array literals */                \
+    X(SETK, "abi")    /* set(a, imm, b) */                                  \
+    X(STRING, "as")   /* a = fresh array on string constant imm */          \
+    X(HALT, "")
+
+enum class Opcode : uint8_t {
+#define QUETZAL_OPCODE_ENUM(name, operands) name,
+    QUETZAL_OPCODES(QUETZAL_OPCODE_ENUM)
+#undef QUETZAL_OPCODE_ENUM
+    Count
+};
+
+constexpr size_t OPCODE_COUNT = static_cast<size_t>(Opcode::Count);
+constexpr size_t MAX_REGISTERS = 256;
+
+struct Instruction {
+    Opcode op;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+    int32_t imm;
+};
+static_assert(sizeof(Instruction) == 8, "instructions are meant to stay 8 bytes");
+
+struct BytecodeFunction {
+    std::string name;
+    uint32_t entry;          // Index of the first instruction
+    uint32_t paramCount;
+    uint32_t registerCount;  // Locals plus temporaries
+};
+
+struct BytecodeProgram {
+    std::vector<Instruction> code;
+    std::vector<uint32_t> lines;               // Source line of each instruction
+    std::vector<BytecodeFunction> functions;
+    std::vector<std::vector<int32_t>> strings; // Decoded string literals, each distinct one once
+    uint32_t globalCount = 0;
+    uint32_t entry = 0;  // Function that initialises the globals and calls main
+
+    static const char* opcodeName(Opcode op);
+    // One past a function's last instruction: the next function's entry
+    uint32_t functionEnd(size_t function) const;
+    // Listing of every function, for --bytecode
+    void disassemble(BufferedWriter& out) const;
+};
+
+#endif //TC3002_COMPILER_BYTECODE_H
@@ -0,0 +1,474 @@
+#include "BytecodeCompiler.h"
+#include "../Lexer/Lexer.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+static Opcode arithmeticOpcode(TokenKind op) {
+    switch (op) {
+        case TokenKind::PLUS: return Opcode::ADD;
+        case TokenKind::MINUS: return Opcode::SUB;
+        case TokenKind::ASTERISK: return Opcode::MUL;
+        case TokenKind::SLASH: return Opcode::DIV;
+        case TokenKind::PERCENT: return Opcode::MOD;
+        case TokenKind::EQUAL: return Opcode::EQ;
+        case TokenKind::NOT_EQUAL: return Opcode::NE;
+        case TokenKind::LESS: return Opcode::LT;
+        case TokenKind::LESS_EQUAL: return Opcode::LE;
+        case TokenKind::GREATER: return Opcode::GT;
+        case TokenKind::GREATER_EQUAL: return Opcode::GE;
+        default: throw runtime_error("Unsupported binary operator");
+    }
+}
+
+// Compare-and-jump taken when the comparison holds, or when it fails if negated
+static Opcode jumpOpcode(TokenKind op, bool negate) {
+    switch (op) {
+        case TokenKind::EQUAL: return negate ? Opcode::JNE : Opcode::JEQ;
+        case TokenKind::NOT_EQUAL: return negate ? Opcode::JEQ : Opcode::JNE;
+        case TokenKind::LESS: return negate ? Opcode::JGE : Opcode::JLT;
+        case TokenKind::LESS_EQUAL: return negate ? Opcode::JGT : Opcode::JLE;
+        case TokenKind::GREATER: return negate ? Opcode::JLE : Opcode::JGT;
+        case TokenKind::GREATER_EQUAL: return negate ? Opcode::JLT : Opcode::JGE;
+        default: return Opcode::Count;
+    }
+}
+
+static bool isLiteral(NodeKind kind) {
+    return kind == NodeKind::IntLiteral || kind == NodeKind::CharLiteral || kind == NodeKind::BoolLiteral;
+}
+
+BytecodeCompiler::BytecodeCompiler(const Ast& ast, string_view source, const ProgramInfo& info)
+    : ast(ast), source(source), info(info) {
+    // Children are created before their parents, so one forward sweep
+    // propagates the flag up the tree
+    assigns.assign(ast.size(), 0);
+    for (NodeId id = 0; id < ast.size(); id++) {
+        const Node& n = ast.node(id);
+        uint8_t flag = n.kind == NodeKind::Assign;
+        for (uint32_t i = 0; i < n.count && !flag; i++) {
+            flag = assigns[ast.child(id, i)];
+        }
+        assigns[id] = flag;
+    }
+}
+
+BytecodeProgram BytecodeCompiler::compile() {
+    if (info.mainFunction == UNRESOLVED) {
+        throw runtime_error("Missing 'main' function");
+    }
+    program.globalCount = static_cast<uint32_t>(info.globals.size());
+    for (const auto& function : info.functions) {
+        program.functions.push_back({string(ast.text(function.node, source)), 0, function.paramCount, 0});
+    }
+    for (size_t i = 0; i < info.functions.size(); i++) {
+        compileFunction(i);
+    }
+    compileEntry();
+    return std::move(program);
+}
+
+/* Helpers */
+uint32_t BytecodeCompiler::emit(Opcode op, uint32_t a, uint32_t b, uint32_t c, int32_t imm) {
+    program.code.push_back({op, static_cast<uint8_t>(a), static_cast<uint8_t>(b), static_cast<uint8_t>(c), imm});
+    program.lines.push_back(line);
+    return here() - 1;
+}
+
+void BytecodeCompiler::patch(const vector<uint32_t>& jumps) {
+    for (uint32_t jump : jumps) patch(jump);
+}
+
+uint32_t BytecodeCompiler::newTemp() {
+    if (nextTemp >= MAX_REGISTERS) {
+        throw runtime_error("Function '" + string(functionName) + "' needs more than "
+                            + to_string(MAX_REGISTERS) + " registers");
+    }
+    registerCount = max(registerCount, nextTemp + 1);
+    return nextTemp++;
+}
+
+bool BytecodeCompiler::isBreak(NodeId id) const {
+    const Node& n = ast.node(id);
+    if (n.kind == NodeKind::Block && n.count == 1) return isBreak(ast.child(id, 0));
+    return n.kind == NodeKind::Break;
+}
+
+void BytecodeCompiler::at(NodeId id) {
+    if (ast.node(id).ref != NO_REF) line = ast.refOf(id).line;
+}
+
+/* Functions */
+void BytecodeCompiler::compileFunction(size_t index) {
+    const FunctionInfo& function = info.functions[index];
+    const Node& n = ast.node(function.node);
+    functionName = program.functions[index].name;
+    if (function.frameSize > MAX_REGISTERS) {
+        throw runtime_error("Function '" + string(functionName) + "' has more than "
+                            + to_string(MAX_REGISTERS) + " locals");
+    }
+
+    at(function.node);
+    program.functions[index].entry = here();
+    firstTemp = nextTemp = function.frameSize;
+    // At least one register, which receives the return value
+    registerCount = max(function.frameSize, 1u);
+    statement(ast.child(function.node, n.count - 1));
+    emit(Opcode::RET0);  // Falling off the end returns 0
+    program.functions[index].registerCount = registerCount;
+}
+
+void BytecodeCompiler::compileEntry() {
+    // Initialises the globals in declaration order, then runs main
+    program.entry = static_cast<uint32_t>(program.functions.size());
+    program.functions.push_back({"<init>", here(), 0, 0});
+    functionName = "<init>";
+    firstTemp = nextTemp = 0;
+    registerCount = 1;
+    for (uint32_t global = 0; global < info.globals.size(); global++) {
+        NodeId declarator = info.globals[global];
+        if (ast.node(declarator).count == 0) continue;  // Globals start at 0
+        at(declarator);
+        uint32_t value = expression(ast.child(declarator, 0));
+        emit(Opcode::SETG, value, 0, 0, static_cast<int32_t>(global));
+        nextTemp = firstTemp;
+    }
+    emit(Opcode::CALL, nextTemp, 0, 0, static_cast<int32_t>(info.mainFunction));
+    emit(Opcode::HALT);
+    program.functions.back().registerCount = registerCount;
+}
+
+/* Statements */
+void BytecodeCompiler::statement(NodeId id) {
+    const Node& n = ast.node(id);
+    at(id);
+    uint32_t mark = nextTemp;
+    switch (n.kind) {
+        case NodeKind::Block:
+            for (uint32_t i = 0; i < n.count; i++) statement(ast.child(id, i));
+            break;
+        case NodeKind::VarDecl:
+            for (uint32_t i = 0; i < n.count; i++) {
+                NodeId declarator = ast.child(id, i);
+                uint32_t slot = info.slots[declarator];
+                at(declarator);
+                // Declaration re-runs in loops reset the variable as well
+                if (ast.node(declarator).count > 0) {
+                    into(ast.child(declarator, 0), slot);
+                } else {
+                    emit(Opcode::LOADI, slot);
+                }
+            }
+            break;
+        case NodeKind::If:
+            ifStatement(id);
+            break;
+        case NodeKind::Loop:
+            loopStatement(id);
+            break;
+        case NodeKind::Break:
+            breakJumps.push_back(emit(Opcode::JMP));
+            break;
+        case NodeKind::Return:
+            if (n.count > 0) {
+                emit(Opcode::RET, expression(ast.child(id, 0)));
+            } else {
+                emit(Opcode::RET0);
+            }
+            break;
+        case NodeKind::Inc:
+        case NodeKind::Dec: {
+            Opcode op = n.kind == NodeKind::Inc ? Opcode::INC : Opcode::DEC;
+            uint32_t slot = info.slots[id];
+            if (isLocal(slot)) {
+                emit(op, slot);
+            } else {
+                uint32_t temp = newTemp();
+                auto global = static_cast<int32_t>(slot & ~GLOBAL_SLOT);
+                emit(Opcode::GETG, temp, 0, 0, global);
+                emit(op, temp);
+                emit(Opcode::SETG, temp, 0, 0, global);
+            }
+            break;
+        }
+        case NodeKind::ExprStmt:
+            effect(ast.child(id, 0));
+            break;
+        default:
+            break;
+    }
+    nextTemp = mark;
+}
+
+void BytecodeCompiler::ifStatement(NodeId id) {
+    const Node& n = ast.node(id);
+    vector<uint32_t> exits;
+    uint32_t i = 0;
+    for (; i + 1 < n.count; i += 2) {
+        if (isBreak(ast.child(id, i + 1))) {
+            // 'if (c) { break; }' jumps straight out of the loop
+            branch(ast.child(id, i), true, breakJumps);
+            continue;
+        }
+        vector<uint32_t> skip;
+        branch(ast.child(id, i), false, skip);
+        statement(ast.child(id, i + 1));
+        if (i + 2 < n.count) exits.push_back(emit(Opcode::JMP));
+        patch(skip);
+    }
+    if (i < n.count) statement(ast.child(id, i));  // else
+    patch(exits);
+}
+
+void BytecodeCompiler::loopStatement(NodeId id) {
+    const Node& n = ast.node(id);
+    size_t breakMark = breakJumps.size();
+    uint32_t top = here();
+    if (n.count == 2) {
+        // A condition makes it a while loop
+        vector<uint32_t> exits;
+        branch(ast.child(id, 0), false, exits);
+        breakJumps.insert(breakJumps.end(), exits.begin(), exits.end());
+    }
+    statement(ast.child(id, n.count - 1));
+    emit(Opcode::JMP, 0, 0, 0, static_cast<int32_t>(top));
+    for (size_t i = breakMark; i < breakJumps.size(); i++) patch(breakJumps[i]);
+    breakJumps.resize(breakMark);
+}
+
+void BytecodeCompiler::effect(NodeId id) {
+    // An expression evaluated only for what it does
+    switch (ast.node(id).kind) {
+        case NodeKind::Assign: assign(id, NO_REGISTER); break;
+        case NodeKind::Call: call(id, NO_REGISTER); break;
+        case NodeKind::ApiCall: apiCall(id, NO_REGISTER); break;
+        default: expression(id); break;
+    }
+}
+
+/* Expressions */
+uint32_t BytecodeCompiler::expression(NodeId id) {
+    if (ast.node(id).kind == NodeKind::Identifier && isLocal(info.slots[id])) {
+        return info.slots[id];
+    }
+    uint32_t temp = newTemp();
+    into(id, temp);
+    return temp;
+}
+
+uint32_t BytecodeCompiler::operand(NodeId id, bool laterAssigns) {
+    // A local read straight from its register must not see an assignment
+    // made while evaluating a later operand
+    uint32_t value = expression(id);
+    if (value < firstTemp && laterAssigns) {
+        uint32_t copy = newTemp();
+        emit(Opcode::MOV, copy, value);
+        return copy;
+    }
+    return value;
+}
+
+void BytecodeCompiler::into(NodeId id, uint32_t dst) {
+    const Node& n = ast.node(id);
+    at(id);
+    uint32_t mark = nextTemp;
+    switch (n.kind) {
+        case NodeKind::IntLiteral:
+        case NodeKind::CharLiteral:
+        case NodeKind::BoolLiteral:
+            emit(Opcode::LOADI, dst, 0, 0, n.value);
+            break;
+        case NodeKind::StringLiteral: {
+            // Equal literals, after escape decoding, share one constant
+            auto [entry, added] = stringIndex.try_emplace(Lexer::decodeString(ast.text(id, source)),
+                                                          static_cast<uint32_t>(program.strings.size()));
+            if (added) program.strings.push_back(entry->first);
+            emit(Opcode::STRING, dst, 0, 0, static_cast<int32_t>(entry->second));
+            break;
+        }
+        case NodeKind::ArrayLiteral: {
+            // Built in a temporary, as an element may read the variable assigned
+            uint32_t array = dst >= firstTemp ? dst : newTemp();
+            emit(Opcode::ARRAY, array, 0, 0, static_cast<int32_t>(n.count));
+            uint32_t elementMark = nextTemp;
+            for (uint32_t i = 0; i < n.count; i++) {
+                uint32_t value = expression(ast.child(id, i));
+                emit(Opcode::SETK, array, value, 0, static_cast<int32_t>(i));
+                nextTemp = elementMark;
+            }
+            if (array != dst) emit(Opcode::MOV, dst, array);
+            break;
+        }
+        case NodeKind::Identifier: {
+            uint32_t slot = info.slots[id];
+            if (!isLocal(slot)) {
+                emit(Opcode::GETG, dst, 0, 0, static_cast<int32_t>(slot & ~GLOBAL_SLOT));
+            } else if (slot != dst) {
+                emit(Opcode::MOV, dst, slot);
+            }
+            break;
+        }
+        case NodeKind::Assign:
+            assign(id, dst);
+            break;
+        case NodeKind::Binary:
+            binary(id, dst);
+            break;
+        case NodeKind::Unary: {
+            NodeId operand = ast.child(id, 0);
+            if (n.op == TokenKind::PLUS) {
+                into(operand, dst);
+            } else {
+                emit(n.op == TokenKind::MINUS ? Opcode::NEG : Opcode::NOT, dst, expression(operand));
+            }
+            break;
+        }
+        case NodeKind::Call:
+            call(id, dst);
+            break;
+        case NodeKind::ApiCall:
+            apiCall(id, dst);
+            break;
+        default:
+            emit(Opcode::LOADI, dst);
+            break;
+    }
+    nextTemp = mark;
+}
+
+void BytecodeCompiler::assign(NodeId id, uint32_t dst) {
+    uint32_t slot = info.slots[id];
+    NodeId value = ast.child(id, 0);
+    if (isLocal(slot)) {
+        into(value, slot);
+        if (dst != NO_REGISTER && dst != slot) emit(Opcode::MOV, dst, slot);
+        return;
+    }
+    uint32_t mark = nextTemp;
+    uint32_t temp = dst != NO_REGISTER ? dst : newTemp();
+    into(value, temp);
+    emit(Opcode::SETG, temp, 0, 0, static_cast<int32_t>(slot & ~GLOBAL_SLOT));
+    nextTemp = mark;
+}
+
+void BytecodeCompiler::binary(NodeId id, uint32_t dst) {
+    const Node& n = ast.node(id);
+    if (n.op == TokenKind::AND || n.op == TokenKind::OR) {
+        logical(id, dst);
+        return;
+    }
+    NodeId left = ast.child(id, 0);
+    NodeId right = ast.child(id, 1);
+    const Node& r = ast.node(right);
+    if ((n.op == TokenKind::PLUS || n.op == TokenKind::MINUS) && r.kind == NodeKind::IntLiteral) {
+        // Constant addend folded into the instruction; negation wraps like SUB
+        auto value = static_cast<uint32_t>(r.value);
+        auto addend = static_cast<int32_t>(n.op == TokenKind::PLUS ? value : 0u - value);
+        emit(Opcode::ADDI, dst, expression(left), 0, addend);
+        return;
+    }
+    uint32_t l = operand(left, assigns[right]);
+    emit(arithmeticOpcode(n.op), dst, l, expression(right));
+}
+
+void BytecodeCompiler::logical(NodeId id, uint32_t dst) {
+    // The left value is computed into the result register, which must not be
+    // a variable the right operand may still read
+    const Node& n = ast.node(id);
+    uint32_t result = dst >= firstTemp ? dst : newTemp();
+    into(ast.child(id, 0), result);
+    uint32_t skip;
+    if (n.op == TokenKind::AND) {
+        skip = emit(Opcode::JZ, result);  // A false left operand is already 0
+    } else {
+        emit(Opcode::BOOL, result, result);
+        skip = emit(Opcode::JNZ, result);
+    }
+    into(ast.child(id, 1), result);
+    emit(Opcode::BOOL, result, result);
+    patch(skip);
+    if (result != dst) emit(Opcode::MOV, dst, result);
+}
+
+void BytecodeCompiler::call(NodeId id, uint32_t dst) {
+    // Arguments go to consecutive registers, which become the callee's
+    // parameters; the callee's result comes back in the first of them
+    const Node& n = ast.node(id);
+    // A result bound for the topmost temporary can be the frame base itself
+    bool inPlace = dst != NO_REGISTER && dst >= firstTemp && dst + 1 == nextTemp;
+    uint32_t base = inPlace ? dst : nextTemp;
+    for (uint32_t i = 0; i < n.count; i++) {
+        into(ast.child(id, i), i == 0 && inPlace ? base : newTemp());
+    }
+    if (base >= MAX_REGISTERS) newTemp();  // Reports the overflow
+    emit(Opcode::CALL, base, 0, 0, static_cast<int32_t>(info.slots[id]));
+    if (dst != NO_REGISTER && dst != base) emit(Opcode::MOV, dst, base);
+    nextTemp = inPlace ? base + 1 : base;
+}
+
+void BytecodeCompiler::apiCall(NodeId id, uint32_t dst) {
+    const Node& n = ast.node(id);
+    if (n.count != static_cast<uint32_t>(apiArity(n.op))) {
+        throw runtime_error("Wrong number of arguments to '" + string(ast.text(id, source)) + "'");
+    }
+    uint32_t args[3] = {};
+    for (uint32_t i = 0; i < n.count; i++) {
+        bool laterAssigns = false;
+        for (uint32_t j = i + 1; j < n.count; j++) laterAssigns |= assigns[ast.child(id, j)] != 0;
+        args[i] = operand(ast.child(id, i), laterAssigns);
+    }
+    auto result = [&] { return dst != NO_REGISTER ? dst : newTemp(); };
+
+    switch (n.op) {
+        case TokenKind::READI: emit(Opcode::READI, result()); return;
+        case TokenKind::READS: emit(Opcode::READS, result()); return;
+        case TokenKind::NEW: emit(Opcode::NEW, result(), args[0]); return;
+        case TokenKind::SIZE: emit(Opcode::SIZE, result(), args[0]); return;
+        case TokenKind::GET:
+            emit(n.flags & IN_BOUNDS ? Opcode::GETU : Opcode::GET, result(), args[0], args[1]);
+            return;
+        case TokenKind::PRINTI: emit(Opcode::PRINTI, args[0]); break;
+        case TokenKind::PRINTC: emit(Opcode::PRINTC, args[0]); break;
+        case TokenKind::PRINTS: emit(Opcode::PRINTS, args[0]); break;
+        case TokenKind::PRINTLN: emit(Opcode::PRINTLN); break;
+        case TokenKind::ADD: emit(Opcode::APPEND, args[0], args[1]); break;
+        case TokenKind::SET:
+            emit(n.flags & IN_BOUNDS ? Opcode::SETU : Opcode::SET, args[0], args[1], args[2]);
+            break;
+        default: break;
+    }
+    // The remaining API functions all return 0
+    if (dst != NO_REGISTER) emit(Opcode::LOADI, dst);
+}
+
+void BytecodeCompiler::branch(NodeId id, bool when, vector<uint32_t>& jumps) {
+    const Node& n = ast.node(id);
+    at(id);
+    uint32_t mark = nextTemp;
+    if (n.kind == NodeKind::Unary && n.op == TokenKind::NOT) {
+        branch(ast.child(id, 0), !when, jumps);
+    } else if (n.kind == NodeKind::Binary && (n.op == TokenKind::AND || n.op == TokenKind::OR)) {
+        // 'and' jumping on true and 'or' jumping on false need both operands;
+        // the other two cases are decided by either one
+        bool both = (n.op == TokenKind::AND) == when;
+        if (both) {
+            vector<uint32_t> skip;
+            branch(ast.child(id, 0), !when, skip);
+            branch(ast.child(id, 1), when, jumps);
+            patch(skip);
+        } else {
+            branch(ast.child(id, 0), when, jumps);
+            branch(ast.child(id, 1), when, jumps);
+        }
+    } else if (n.kind == NodeKind::Binary && jumpOpcode(n.op, false) != Opcode::Count) {
+        NodeId right = ast.child(id, 1);
+        uint32_t l = operand(ast.child(id, 0), assigns[right]);
+        jumps.push_back(emit(jumpOpcode(n.op, !when), l, expression(right)));
+    } else if (isLiteral(n.kind)) {
+        if ((n.value != 0) == when) jumps.push_back(emit(Opcode::JMP));
+    } else {
+        jumps.push_back(emit(when ? Opcode::JNZ : Opcode::JZ, expression(id)));
+    }
+    nextTemp = mark;
+}
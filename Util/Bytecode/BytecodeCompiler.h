@@ -0,0 +1,72 @@
+#ifndef TC3002_COMPILER_BYTECODECOMPILER_H
+#define TC3002_COMPILER_BYTECODECOMPILER_H
+
+#include "Bytecode.h"
+#include "../AST/AST.h"
+#include "../Semantic/SemanticAnalyzer.h"
+#include <map>
+#include <string_view>
+#include <vector>
+
+// Lowers a checked syntax tree to register bytecode. Locals live in fixed
+// registers, so reading a variable costs no instruction; temporaries are
+// handed out stack-wise above them and released as soon as an expression is
+// done. Conditions compile to compare-and-jump instructions, with 'and',
+// 'or' and 'not' turned into control flow instead of values.
+class BytecodeCompiler {
+private:
+    static constexpr uint32_t NO_REGISTER = UINT32_MAX;
+
+    const Ast& ast;
+    std::string_view source;
+    const ProgramInfo& info;
+    BytecodeProgram program;
+    std::vector<uint8_t> assigns;  // Per node: its subtree contains an Assign
+    std::map<std::vector<int32_t>, uint32_t> stringIndex;  // Decoded literal to its program.strings slot
+
+    // State of the function being compiled
+    std::string_view functionName;
+    uint32_t firstTemp = 0;
+    uint32_t nextTemp = 0;
+    uint32_t registerCount = 0;
+    uint32_t line = 0;                 // Stamped on every emitted instruction
+    std::vector<uint32_t> breakJumps;  // Unpatched 'break' jumps of the enclosing loops
+
+    uint32_t emit(Opcode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, int32_t imm = 0);
+    uint32_t here() const { return static_cast<uint32_t>(program.code.size()); }
+    void patch(uint32_t jump) { program.code[jump].imm = static_cast<int32_t>(here()); }
+    void patch(const std::vector<uint32_t>& jumps);
+    uint32_t newTemp();
+    void at(NodeId id);
+    bool isBreak(NodeId id) const;  // A 'break', alone or as the only statement of a block
+    bool isLocal(uint32_t slot) const { return !(slot & GLOBAL_SLOT); }
+
+    void compileFunction(size_t index);
+    void compileEntry();
+
+    // Statements
+    void statement(NodeId id);
+    void ifStatement(NodeId id);
+    void loopStatement(NodeId id);
+    void effect(NodeId id);
+
+    // Expressions. expression() returns the register holding the value, which
+    // for a local is the local itself; into() evaluates into a given register
+    uint32_t expression(NodeId id);
+    uint32_t operand(NodeId id, bool laterAssigns);
+    void into(NodeId id, uint32_t dst);
+    void assign(NodeId id, uint32_t dst);
+    void binary(NodeId id, uint32_t dst);
+    void logical(NodeId id, uint32_t dst);
+    void call(NodeId id, uint32_t dst);
+    void apiCall(NodeId id, uint32_t dst);
+    // Emits jumps, collected in `jumps`, taken when the condition equals `when`
+    void branch(NodeId id, bool when, std::vector<uint32_t>& jumps);
+
+public:
+    BytecodeCompiler(const Ast& ast, std::string_view source, const ProgramInfo& info);
+    // Throws a runtime_error if a function needs more than MAX_REGISTERS registers
+    BytecodeProgram compile();
+};
+
+#endif //TC3002_COMPILER_BYTECODECOMPILER_H
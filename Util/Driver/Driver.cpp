@@ -0,0 +1,338 @@
+#include "Driver.h"
+#include "../Lexer/Lexer.h"
+#include "../Parser/Parser.h"
+#include "../Semantic/SemanticAnalyzer.h"
+#include "../Optimizer/Optimizer.h"
+#include "../Bytecode/BytecodeCompiler.h"
+#include "../VM/VM.h"
+#include "../Native/CGenerator.h"
+#include "../Native/Toolchain.h"
+#include "../Native/X86Generator.h"
+#include "../SourceBuffer/SourceBuffer.h"
+#include "../ThreadPool/ThreadPool.h"
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static bool isSourceFile(const fs::path& path) {
+    auto extension = path.extension();
+    return extension == ".quetzal" || extension == ".qtz";
+}
+
+vector<string> collectSourceFiles(const vector<string>& inputs) {
+    vector<string> files;
+    for (const auto& input : inputs) {
+        error_code ec;
+        if (!fs::is_directory(input, ec)) {
+            files.push_back(input);
+            continue;
+        }
+
+        vector<string> found;
+        for (const auto& entry : fs::recursive_directory_iterator(input)) {
+            if (entry.is_regular_file() && isSourceFile(entry.path())) {
+                found.push_back(entry.path().string());
+            }
+        }
+        sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+// The source path without its extension, unless that is the source itself
+static string executablePath(const string& path, const CompileOptions& options) {
+    if (!options.outputPath.empty()) return options.outputPath;
+    fs::path executable = fs::path(path).replace_extension();
+    return executable == fs::path(path) ? path + ".out" : executable.string();
+}
+
+FileResult compileFile(const string& path, const CompileOptions& options,
+                       BufferedWriter& out, BufferedWriter* binaryOut) {
+    FileResult result;
+    result.path = path;
+    instrumentation::take();  // Drop whatever an earlier task left on this thread
+    try {
+        SourceBuffer source = [&] {
+            QUETZAL_PHASE(Read);
+            return SourceBuffer::fromFile(path);
+        }();
+        result.bytes = source.size();
+        Lexer lexer(source);
+        Interner symbols;
+        lexer.useInterner(symbols);
+
+        Ast ast;
+        if (options.needsTokenBuffer()) {
+            TokenBuffer tokens;
+            {
+                QUETZAL_PHASE(Lex);
+                lexer.tokenize(tokens);
+            }
+            result.tokenCount = tokens.size();
+            QUETZAL_COUNT_TOKENS(tokens);
+
+            if (options.printTokens) writeTokens(out, tokens, source.view());
+            if (options.printStatistics) writeTokenStatistics(out, tokens);
+            if (options.binaryTokens && binaryOut) writeBinaryTokens(*binaryOut, path, tokens);
+
+            QUETZAL_PHASE(Parse);
+            Parser parser(std::move(tokens), source.view());
+            ast = parser.parse(result.diagnostics);
+        } else {
+            // Lexing happens inside the parse, on demand
+            QUETZAL_PHASE(Parse);
+            Parser parser(lexer);
+            ast = parser.parse(result.diagnostics);
+        }
+        result.nodeCount = ast.size();
+
+        // Names are only checked in a tree without syntax errors
+        ProgramInfo info;
+        if (result.diagnostics.empty()) {
+            QUETZAL_PHASE(Analyze);
+            info = SemanticAnalyzer(ast, source.view(), symbols).analyze(result.diagnostics);
+        }
+        result.success = result.diagnostics.empty();
+
+        if (result.success && options.optimize && (options.needsBytecode() || options.needsC())) {
+            QUETZAL_PHASE(Optimize);
+            Optimizer(ast, info).optimize();
+        }
+
+        if (result.success && options.needsBytecode()) {
+            BytecodeProgram program = [&] {
+                QUETZAL_PHASE(Codegen);
+                return BytecodeCompiler(ast, source.view(), info).compile();
+            }();
+            if (options.printBytecode) program.disassemble(out);
+            if (options.printAssembly || options.native) {
+                BufferedWriter assembly;
+                {
+                    QUETZAL_PHASE(Codegen);
+                    X86Generator(program).generate(assembly);
+                }
+                string text = assembly.take();
+                if (options.printAssembly) out << text;
+                if (options.native && !options.viaC) {
+                    QUETZAL_PHASE(Link);
+                    linkExecutable(text, executablePath(path, options));
+                }
+            }
+            if (options.run) {
+                QUETZAL_PHASE(Run);
+                VM vm(program, out);
+                auto count = [&vm] {
+                    QUETZAL_COUNT_BY(InstructionsExecuted, vm.instructionsExecuted());
+                    [[maybe_unused]] const ArrayStore::Statistics& gc = vm.arrayStore().statistics();
+                    QUETZAL_COUNT_BY(Collections, gc.collections);
+                    QUETZAL_COUNT_BY(CollectionMicros, static_cast<uint64_t>(gc.pauseSeconds * 1e6));
+                    QUETZAL_COUNT_BY(ArraysReclaimed, gc.arraysReclaimed);
+                    QUETZAL_COUNT_BY(ArrayBytesReclaimed, gc.bytesReclaimed);
+                };
+                try {
+                    vm.run();
+                } catch (const runtime_error&) {
+                    count();
+                    throw;
+                }
+                count();
+            }
+        }
+
+        if (result.success && options.needsC()) {
+            BufferedWriter translation;
+            {
+                QUETZAL_PHASE(Codegen);
+                CGenerator(ast, source.view(), info).generate(translation);
+            }
+            string text = translation.take();
+            if (options.printC) out << text;
+            if (options.native && options.viaC) {
+                QUETZAL_PHASE(Link);
+                compileC(text, executablePath(path, options));
+            }
+        }
+
+        if (options.printAst) ast.dump(out, source.view());
+    } catch (const exception& e) {
+        result.diagnostics.push_back(e.what());
+        result.success = false;
+    }
+    result.metrics = instrumentation::take();
+    return result;
+}
+
+FileResult compileFile(const string& path) {
+    BufferedWriter discard;
+    return compileFile(path, CompileOptions{}, discard);
+}
+
+vector<FileResult> compileFiles(const vector<string>& paths, size_t jobs) {
+    BufferedWriter discard;
+    return compileFiles(paths, jobs, CompileOptions{}, discard);
+}
+
+vector<FileResult> compileFiles(const vector<string>& paths, size_t jobs, const CompileOptions& options,
+                                BufferedWriter& out, BufferedWriter* binaryOut) {
+    vector<FileResult> results(paths.size());
+    if (paths.empty()) return results;
+
+    if (jobs == 0) jobs = max(1u, thread::hardware_concurrency());
+    jobs = min(jobs, paths.size());
+    if (jobs == 1) {
+        // Nothing to reorder, so output goes straight to the writers
+        for (size_t i = 0; i < paths.size(); i++) {
+            results[i] = compileFile(paths[i], options, out, binaryOut);
+        }
+        return results;
+    }
+
+    // Submitted smallest first: workers pop the newest task of their own
+    // deque, so each starts on its largest file and a big file picked up
+    // last cannot leave the others idle
+    vector<pair<uintmax_t, size_t>> order;
+    for (size_t i = 0; i < paths.size(); i++) {
+        error_code ec;
+        uintmax_t size = fs::file_size(paths[i], ec);
+        order.push_back({ec ? 0 : size, i});
+    }
+    stable_sort(order.begin(), order.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // Each task fills only its own slots; the calling thread then writes the
+    // outputs in input order, each as soon as it is ready
+    vector<string> texts(paths.size()), binaries(paths.size());
+    vector<char> done(paths.size(), 0);
+    mutex doneMutex;
+    condition_variable doneChanged;
+
+    ThreadPool pool(jobs);
+    for (const auto& [size, i] : order) {
+        pool.submit([&, i = i] {
+            BufferedWriter text, binary;
+            results[i] = compileFile(paths[i], options, text, binaryOut ? &binary : nullptr);
+            texts[i] = text.take();
+            binaries[i] = binary.take();
+            {
+                lock_guard<mutex> lock(doneMutex);
+                done[i] = 1;
+            }
+            doneChanged.notify_all();
+        });
+    }
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        {
+            unique_lock<mutex> lock(doneMutex);
+            doneChanged.wait(lock, [&] { return done[i] != 0; });
+        }
+        out << texts[i];
+        if (binaryOut) *binaryOut << binaries[i];
+        string().swap(texts[i]);
+        string().swap(binaries[i]);
+    }
+    pool.wait();
+    return results;
+}
+
+/* Listings */
+void writeTokens(BufferedWriter& out, const TokenBuffer& tokens, string_view source) {
+    for (size_t i = 0; i < tokens.size(); i++) {
+        const TokenSpan& span = tokens.spans[i];
+        out << '[' << tokens.locations[i].line << ':' << tokens.locations[i].column << "] "
+            << Lexer::tokenKindToString(tokens.kinds[i])
+            << " '" << source.substr(span.offset, span.length) << "'\n";
+    }
+}
+
+void writeTokenStatistics(BufferedWriter& out, const TokenBuffer& tokens) {
+    // Count non-whitespace, non-comment tokens
+    size_t counts[TOKEN_KIND_COUNT] = {};
+    size_t totalTokens = 0;
+    for (TokenKind kind : tokens.kinds) {
+        if (kind != TokenKind::SPACE &&
+            kind != TokenKind::LINE_COMMENT &&
+            kind != TokenKind::BLOCK_COMMENT) {
+            counts[static_cast<size_t>(kind)]++;
+            totalTokens++;
+        }
+    }
+    size_t distinct = 0;
+    for (size_t count : counts) {
+        if (count > 0) distinct++;
+    }
+
+    out << "\n=== Token Analysis ===\n";
+    out << "Total significant tokens: " << totalTokens << "\n";
+    out << "Distinct token types: " << distinct << "\n\n";
+    out << "Token frequency:\n";
+    out << "----------------\n";
+    for (size_t kind = 0; kind < TOKEN_KIND_COUNT; kind++) {
+        if (counts[kind] > 0) {
+            out << Lexer::tokenKindToString(static_cast<TokenKind>(kind)) << ": " << counts[kind] << "\n";
+        }
+    }
+}
+
+void writeBinaryHeader(BufferedWriter& out) {
+    out << "QTOK";
+    out.writeRaw<uint32_t>(1);
+}
+
+void writeBinaryTokens(BufferedWriter& out, const string& path, const TokenBuffer& tokens) {
+    out.writeRaw(static_cast<uint32_t>(path.size()));
+    out << path;
+    out.writeRaw(static_cast<uint32_t>(tokens.size()));
+    for (size_t i = 0; i < tokens.size(); i++) {
+        out.writeRaw(static_cast<uint8_t>(tokens.kinds[i]));
+        out.writeRaw(tokens.spans[i].offset);
+        out.writeRaw(tokens.spans[i].length);
+        out.writeRaw(tokens.locations[i].line);
+        out.writeRaw(tokens.locations[i].column);
+    }
+}
+
+void writeJsonReport(ostream& out, const vector<FileResult>& results, size_t jobs, double wallSeconds) {
+    Metrics totals;
+    size_t bytes = 0, tokens = 0, failed = 0;
+    for (const auto& result : results) {
+        totals.merge(result.metrics);
+        bytes += result.bytes;
+        tokens += result.tokenCount;
+        if (!result.success) failed++;
+    }
+
+    out << "{\"instrumented\":" << (QUETZAL_INSTRUMENTED ? "true" : "false")
+        << ",\"jobs\":" << jobs
+        << ",\"wallSeconds\":" << wallSeconds
+        << ",\"peakMemoryBytes\":" << instrumentation::peakMemoryBytes()
+        << ",\"fileCount\":" << results.size()
+        << ",\"failedCount\":" << failed
+        << ",\"totals\":";
+    // Totals sum per-file phase times, so they exceed wallSeconds when parallel
+    instrumentation::writeJson(out, totals, bytes, tokens);
+    out << ",\"files\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        const FileResult& result = results[i];
+        if (i > 0) out << ',';
+        out << "\n{\"path\":";
+        instrumentation::writeJsonString(out, result.path);
+        out << ",\"success\":" << (result.success ? "true" : "false")
+            << ",\"nodes\":" << result.nodeCount << ",\"diagnostics\":[";
+        for (size_t d = 0; d < result.diagnostics.size(); d++) {
+            if (d > 0) out << ',';
+            instrumentation::writeJsonString(out, result.diagnostics[d]);
+        }
+        out << "],\"metrics\":";
+        instrumentation::writeJson(out, result.metrics, result.bytes, result.tokenCount);
+        out << '}';
+    }
+    out << "]}\n";
+}
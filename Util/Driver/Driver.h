@@ -0,0 +1,83 @@
+#ifndef TC3002_COMPILER_DRIVER_H
+#define TC3002_COMPILER_DRIVER_H
+
+#include "../../Token/TokenBuffer.h"
+#include "../Instrumentation/Instrumentation.h"
+#include "../Output/BufferedWriter.h"
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What to produce for each file besides the pass/fail result
+struct CompileOptions {
+    bool printTokens = false;      // Text token stream
+    bool printStatistics = false;  // Token frequency table
+    bool printAst = false;         // Indented syntax tree
+    bool binaryTokens = false;     // Compact binary token records
+    bool collectMetrics = false;   // Token counts for the JSON report
+    bool printBytecode = false;    // Disassembled bytecode
+    bool run = false;              // Execute on the VM, reading stdin; output goes to `out`
+    bool printAssembly = false;    // x86-64 assembly
+    bool native = false;           // Link a native executable with the system toolchain
+    bool printC = false;           // C translation
+    bool viaC = false;             // Build the native executable from C instead of assembly
+    bool optimize = true;          // Fold constants and remove dead code before code generation
+    std::string outputPath;        // The executable; by default the source path without its extension
+
+    // Without any of these the parser pulls tokens straight from the lexer
+    // and no token buffer is built
+    bool needsTokenBuffer() const {
+        return printTokens || printStatistics || binaryTokens || collectMetrics;
+    }
+    bool needsBytecode() const { return printBytecode || run || printAssembly || (native && !viaC); }
+    bool needsC() const { return printC || (native && viaC); }
+};
+
+// Outcome of running the front end over one source file
+struct FileResult {
+    std::string path;
+    bool success = false;
+    size_t bytes = 0;
+    size_t tokenCount = 0;
+    size_t nodeCount = 0;
+    std::vector<std::string> diagnostics;
+    Metrics metrics;
+};
+
+// Expands directories (recursively, .quetzal and .qtz files) and keeps plain
+// paths as given. Directory contents are sorted so runs are reproducible.
+std::vector<std::string> collectSourceFiles(const std::vector<std::string>& inputs);
+
+// Lexes, parses and checks a single file, then compiles, links and runs it
+// if asked. Never throws: errors become diagnostics.
+// Requested text output goes to `out`, binary token records to `binaryOut`.
+FileResult compileFile(const std::string& path, const CompileOptions& options,
+                       BufferedWriter& out, BufferedWriter* binaryOut = nullptr);
+FileResult compileFile(const std::string& path);
+
+// Compiles every file on a work-stealing pool of `jobs` threads (0 = one per
+// core). Results and output come back in the order of `paths`, whatever the
+// scheduling: each file's output is written as soon as it and all files
+// before it are done.
+std::vector<FileResult> compileFiles(const std::vector<std::string>& paths, size_t jobs = 0);
+std::vector<FileResult> compileFiles(const std::vector<std::string>& paths, size_t jobs,
+                                     const CompileOptions& options, BufferedWriter& out,
+                                     BufferedWriter* binaryOut = nullptr);
+
+// Text listings shared by the batch and interactive drivers
+void writeTokens(BufferedWriter& out, const TokenBuffer& tokens, std::string_view source);
+void writeTokenStatistics(BufferedWriter& out, const TokenBuffer& tokens);
+
+// Binary token dump: the magic "QTOK" and a uint32 version once, then per file
+// a uint32 path length, the path, a uint32 token count and per token the kind
+// (uint8) followed by offset, length, line and column (uint32 each), all in
+// host byte order
+void writeBinaryHeader(BufferedWriter& out);
+void writeBinaryTokens(BufferedWriter& out, const std::string& path, const TokenBuffer& tokens);
+
+// Machine-readable summary of a batch: per-file metrics, totals and peak memory
+void writeJsonReport(std::ostream& out, const std::vector<FileResult>& results,
+                     size_t jobs, double wallSeconds);
+
+#endif //TC3002_COMPILER_DRIVER_H
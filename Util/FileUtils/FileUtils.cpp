@@ -1,13 +1,7 @@
 #include "FileUtils.h"
-#include <fstream>
-#include <sstream>
+#include "../SourceBuffer/SourceBuffer.h"
 using namespace std;
 string readFileContents(const string& filePath) {
-    ifstream file(filePath);
-    if (!file) {
-        throw runtime_error("Could not open file: " + filePath);
-    }
-    stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    // Single copy out of the mapping, prefer SourceBuffer to avoid even that
+    return string(SourceBuffer::fromFile(filePath).view());
 }
\ No newline at end of file
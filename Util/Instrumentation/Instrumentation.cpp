@@ -0,0 +1,136 @@
+#include "Instrumentation.h"
+#include "../Lexer/Lexer.h"
+#include <cstdio>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+void Metrics::merge(const Metrics& other) {
+    for (size_t i = 0; i < PHASE_COUNT; i++) phaseSeconds[i] += other.phaseSeconds[i];
+    for (size_t i = 0; i < COUNTER_COUNT; i++) counters[i] += other.counters[i];
+    for (size_t i = 0; i < TOKEN_KIND_COUNT; i++) tokensByKind[i] += other.tokensByKind[i];
+}
+
+namespace instrumentation {
+
+Metrics take() {
+    Metrics metrics = threadMetrics;
+    threadMetrics = Metrics{};
+    return metrics;
+}
+
+void countTokens(const TokenBuffer& tokens) {
+    // Runs over the dense kinds array once, after lexing, instead of
+    // touching a counter for every token inside the lexer loop
+    for (TokenKind kind : tokens.kinds) {
+        threadMetrics.tokensByKind[static_cast<size_t>(kind)]++;
+    }
+}
+
+size_t peakMemoryBytes() {
+#ifndef _WIN32
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);         // Bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;  // Kilobytes on Linux
+#endif
+#else
+    return 0;
+#endif
+}
+
+const char* phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::Read: return "read";
+        case Phase::Lex: return "lex";
+        case Phase::Parse: return "parse";
+        case Phase::Analyze: return "analyze";
+        case Phase::Optimize: return "optimize";
+        case Phase::Codegen: return "codegen";
+        case Phase::Link: return "link";
+        case Phase::Run: return "run";
+        case Phase::Count: break;
+    }
+    return "unknown";
+}
+
+const char* counterName(Counter counter) {
+    switch (counter) {
+        case Counter::SkipCommentsCalls: return "skipCommentsCalls";
+        case Counter::CommentsSkipped: return "commentsSkipped";
+        case Counter::AssignmentBacktracks: return "assignmentBacktracks";
+        case Counter::NegativeLiteralSplits: return "negativeLiteralSplits";
+        case Counter::InstructionsExecuted: return "instructionsExecuted";
+        case Counter::ConstantsFolded: return "constantsFolded";
+        case Counter::DeadCodeRemoved: return "deadCodeRemoved";
+        case Counter::BoundsChecksRemoved: return "boundsChecksRemoved";
+        case Counter::InvariantsHoisted: return "invariantsHoisted";
+        case Counter::Collections: return "collections";
+        case Counter::CollectionMicros: return "collectionMicros";
+        case Counter::ArraysReclaimed: return "arraysReclaimed";
+        case Counter::ArrayBytesReclaimed: return "arrayBytesReclaimed";
+        case Counter::Count: break;
+    }
+    return "unknown";
+}
+
+void writeJsonString(ostream& out, const string& text) {
+    out << '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof escaped, "\\u%04x", c);
+                    out << escaped;
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+
+// Rate per second, or 0 when the phase was not timed
+static double perSecond(double amount, double seconds) {
+    return seconds > 0 ? amount / seconds : 0;
+}
+
+void writeJson(ostream& out, const Metrics& metrics, size_t bytes, size_t tokens) {
+    const double lexSeconds = metrics.phaseSeconds[static_cast<size_t>(Phase::Lex)];
+    const double parseSeconds = metrics.phaseSeconds[static_cast<size_t>(Phase::Parse)];
+
+    out << "{\"bytes\":" << bytes << ",\"tokens\":" << tokens << ",\"phaseSeconds\":{";
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        if (i > 0) out << ',';
+        out << '"' << phaseName(static_cast<Phase>(i)) << "\":" << metrics.phaseSeconds[i];
+    }
+    out << "},\"lexBytesPerSecond\":" << perSecond(static_cast<double>(bytes), lexSeconds)
+        << ",\"parseTokensPerSecond\":" << perSecond(static_cast<double>(tokens), parseSeconds)
+        << ",\"counters\":{";
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        if (i > 0) out << ',';
+        out << '"' << counterName(static_cast<Counter>(i)) << "\":" << metrics.counters[i];
+    }
+    out << "},\"tokensByKind\":{";
+    bool first = true;
+    for (size_t i = 0; i < TOKEN_KIND_COUNT; i++) {
+        if (metrics.tokensByKind[i] == 0) continue;
+        if (!first) out << ',';
+        first = false;
+        out << '"' << Lexer::tokenKindToString(static_cast<TokenKind>(i)) << "\":" << metrics.tokensByKind[i];
+    }
+    out << "}}";
+}
+
+}
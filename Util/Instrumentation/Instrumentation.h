@@ -0,0 +1,102 @@
+#ifndef TC3002_COMPILER_INSTRUMENTATION_H
+#define TC3002_COMPILER_INSTRUMENTATION_H
+
+#include "../../Token/TokenBuffer.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Phase timers and hot-path counters. Everything is recorded through the
+// QUETZAL_* macros below, which expand to nothing when the build defines
+// QUETZAL_NO_INSTRUMENTATION (CMake option QUETZAL_INSTRUMENTATION=OFF).
+
+enum class Phase : uint8_t { Read, Lex, Parse, Analyze, Optimize, Codegen, Link, Run, Count };
+
+enum class Counter : uint8_t {
+    SkipCommentsCalls,      // Parser::skipComments invocations
+    CommentsSkipped,        // Comment tokens stepped over by the parser
+    AssignmentBacktracks,   // Expression reinterpreted as an assignment target
+    NegativeLiteralSplits,  // "n -1" lexed as n, -1 and split back into a subtraction
+    InstructionsExecuted,   // Bytecode instructions run by the VM
+    ConstantsFolded,        // Expressions and variable reads replaced by a literal
+    DeadCodeRemoved,        // Statements and if arms the optimiser deleted
+    BoundsChecksRemoved,    // get/set calls flagged IN_BOUNDS
+    InvariantsHoisted,      // Loop-invariant expressions moved before their loop
+    Collections,            // Array collections run by the VM
+    CollectionMicros,       // Time the VM spent in them, a part of the run phase
+    ArraysReclaimed,        // Arrays they freed
+    ArrayBytesReclaimed,    // Record and element bytes they freed
+    Count
+};
+
+constexpr size_t PHASE_COUNT = static_cast<size_t>(Phase::Count);
+constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+constexpr size_t TOKEN_KIND_COUNT = static_cast<size_t>(TokenKind::UNKNOWN) + 1;
+
+struct Metrics {
+    double phaseSeconds[PHASE_COUNT] = {};
+    uint64_t counters[COUNTER_COUNT] = {};
+    uint64_t tokensByKind[TOKEN_KIND_COUNT] = {};
+
+    void merge(const Metrics& other);
+};
+
+namespace instrumentation {
+    // Per-thread, so parallel compilations never share a cache line. Constant
+    // initialised, which lets each counter bump compile to a single TLS add.
+    inline thread_local Metrics threadMetrics;
+
+    // Returns this thread's metrics and starts a fresh set
+    Metrics take();
+    void countTokens(const TokenBuffer& tokens);
+
+    class PhaseTimer {
+    private:
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit PhaseTimer(Phase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+        ~PhaseTimer() {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            threadMetrics.phaseSeconds[static_cast<size_t>(phase)] += elapsed.count();
+        }
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+    };
+
+    // Peak resident set size of the process, 0 where unavailable
+    size_t peakMemoryBytes();
+
+    const char* phaseName(Phase phase);
+    const char* counterName(Counter counter);
+
+    // JSON helpers for reports
+    void writeJsonString(std::ostream& out, const std::string& text);
+    // Writes a JSON object with phase times, throughput, counters and token kinds
+    void writeJson(std::ostream& out, const Metrics& metrics, size_t bytes, size_t tokens);
+}
+
+#define QUETZAL_CONCAT_IMPL(a, b) a##b
+#define QUETZAL_CONCAT(a, b) QUETZAL_CONCAT_IMPL(a, b)
+
+#ifndef QUETZAL_NO_INSTRUMENTATION
+#define QUETZAL_INSTRUMENTED 1
+#define QUETZAL_PHASE(phase) \
+    ::instrumentation::PhaseTimer QUETZAL_CONCAT(quetzalPhase, __LINE__)(Phase::phase)
+#define QUETZAL_COUNT(counter) \
+    (++::instrumentation::threadMetrics.counters[static_cast<size_t>(Counter::counter)])
+#define QUETZAL_COUNT_BY(counter, amount) \
+    (::instrumentation::threadMetrics.counters[static_cast<size_t>(Counter::counter)] += (amount))
+#define QUETZAL_COUNT_TOKENS(tokens) ::instrumentation::countTokens(tokens)
+#else
+#define QUETZAL_INSTRUMENTED 0
+#define QUETZAL_PHASE(phase) ((void)0)
+#define QUETZAL_COUNT(counter) ((void)0)
+#define QUETZAL_COUNT_BY(counter, amount) ((void)0)
+#define QUETZAL_COUNT_TOKENS(tokens) ((void)0)
+#endif
+
+#endif //TC3002_COMPILER_INSTRUMENTATION_H
@@ -0,0 +1,87 @@
+#include "Interner.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+Interner::Interner(size_t expectedSymbols) {
+    size_t capacity = 16;
+    while (capacity < expectedSymbols * 2) capacity *= 2;
+    slots.assign(capacity, NO_SYMBOL);
+    mask = capacity - 1;
+
+    hashes.reserve(expectedSymbols);
+    offsets.reserve(expectedSymbols + 1);
+    arena.reserve(expectedSymbols * 8);
+
+    // Symbol 0 is the empty name; it never occupies a slot
+    offsets = {0, 0};
+    hashes.push_back(0);
+}
+
+uint32_t Interner::hash(string_view text) {
+    // Word at a time: most identifiers fit in one or two 8-byte loads
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h = text.size() * k;
+    const char* p = text.data();
+    size_t n = text.size();
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ word) * k;
+        h ^= h >> 32;
+    }
+    if (n > 0) {
+        uint64_t word = 0;
+        memcpy(&word, p, n);
+        h = (h ^ word) * k;
+    }
+    h ^= h >> 29;
+    h *= k;
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+size_t Interner::probe(string_view text, uint32_t h) const {
+    // Slot holding the name, or the empty slot where it belongs
+    size_t slot = h & mask;
+    while (true) {
+        SymbolId id = slots[slot];
+        if (id == NO_SYMBOL || (hashes[id] == h && name(id) == text)) return slot;
+        slot = (slot + 1) & mask;
+    }
+}
+
+void Interner::grow() {
+    // Rehashing uses the stored hashes, the names themselves are not touched
+    slots.assign(slots.size() * 2, NO_SYMBOL);
+    mask = slots.size() - 1;
+    for (SymbolId id = 1; id < hashes.size(); id++) {
+        size_t slot = hashes[id] & mask;
+        while (slots[slot] != NO_SYMBOL) slot = (slot + 1) & mask;
+        slots[slot] = id;
+    }
+}
+
+SymbolId Interner::intern(string_view text) {
+    if (text.empty()) return NO_SYMBOL;
+
+    uint32_t h = hash(text);
+    size_t slot = probe(text, h);
+    if (slots[slot] != NO_SYMBOL) return slots[slot];
+
+    if (arena.size() + text.size() > UINT32_MAX) {
+        throw runtime_error("Symbol table full");
+    }
+    auto id = static_cast<SymbolId>(hashes.size());
+    arena.append(text);
+    offsets.push_back(static_cast<uint32_t>(arena.size()));
+    hashes.push_back(h);
+    slots[slot] = id;
+    if (hashes.size() * 2 > slots.size()) grow();
+    return id;
+}
+
+SymbolId Interner::find(string_view text) const {
+    if (text.empty()) return NO_SYMBOL;
+    return slots[probe(text, hash(text))];
+}
@@ -0,0 +1,47 @@
+#ifndef TC3002_COMPILER_INTERNER_H
+#define TC3002_COMPILER_INTERNER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Dense identifier handle. 0 is the empty name, which doubles as "no symbol"
+// for tokens lexed without an interner.
+using SymbolId = uint32_t;
+constexpr SymbolId NO_SYMBOL = 0;
+
+// Maps names to dense 32-bit symbol IDs, so that later phases hash and
+// compare integers instead of strings. The table is flat and open-addressed
+// (linear probing, at most half full) and holds only IDs; the names live back
+// to back in a single arena. Looking up a name that is already interned
+// hashes it once and never allocates.
+class Interner {
+private:
+    std::string arena;               // All names, concatenated
+    std::vector<uint32_t> offsets;   // Symbol i spans [offsets[i], offsets[i + 1])
+    std::vector<uint32_t> hashes;    // Per symbol, to filter probes and rehash
+    std::vector<SymbolId> slots;     // NO_SYMBOL marks an empty slot
+    size_t mask = 0;
+
+    static uint32_t hash(std::string_view text);
+    size_t probe(std::string_view text, uint32_t h) const;
+    void grow();
+
+public:
+    explicit Interner(size_t expectedSymbols = 256);
+
+    // ID of the name, adding it on first sight
+    SymbolId intern(std::string_view text);
+    // ID of the name, or NO_SYMBOL if it was never interned
+    SymbolId find(std::string_view text) const;
+    // The view is invalidated by the next intern() of a new name
+    std::string_view name(SymbolId id) const {
+        return {arena.data() + offsets[id], offsets[id + 1] - offsets[id]};
+    }
+    // Number of symbols, the empty name included
+    size_t size() const { return hashes.size(); }
+    size_t arenaBytes() const { return arena.size(); }
+};
+
+#endif //TC3002_COMPILER_INTERNER_H
@@ -0,0 +1,129 @@
+#ifndef TC3002_COMPILER_CHARTABLES_H
+#define TC3002_COMPILER_CHARTABLES_H
+
+#include "../../TokenKind/TokenKind.h"
+#include <array>
+#include <cstdint>
+
+// Compile-time lexer tables: a 256-entry character classification (locale
+// independent, unlike <cctype>) and the DFA for operators and separators.
+
+/* Character classes */
+
+enum CharClass : uint8_t {
+    CHAR_SPACE       = 1 << 0,  // ' ', '\t', '\n', '\v', '\f', '\r'
+    CHAR_DIGIT       = 1 << 1,
+    CHAR_LETTER      = 1 << 2,  // Latin letters only
+    CHAR_IDENT       = 1 << 3,  // Letters, digits and '_'
+    CHAR_HEX         = 1 << 4,
+    CHAR_NON_ASCII   = 1 << 5,
+};
+
+// What the main lexer loop does with a token's first character
+enum class StartAction : uint8_t {
+    Unknown, Space, Identifier, Number, String, Char, Operator, NonAscii
+};
+
+struct OperatorSpec {
+    const char* spelling;
+    TokenKind kind;
+};
+
+// Every operator and separator. Adding one only means adding its row here;
+// comment openers are listed so the DFA recognises them in the same pass.
+constexpr OperatorSpec operatorSpecs[] = {
+    {"=", TokenKind::ASSIGN}, {"==", TokenKind::EQUAL}, {"!=", TokenKind::NOT_EQUAL},
+    {"<", TokenKind::LESS}, {"<=", TokenKind::LESS_EQUAL},
+    {">", TokenKind::GREATER}, {">=", TokenKind::GREATER_EQUAL},
+    {"+", TokenKind::PLUS}, {"-", TokenKind::MINUS}, {"*", TokenKind::ASTERISK},
+    {"/", TokenKind::SLASH}, {"%", TokenKind::PERCENT},
+    {"(", TokenKind::LPAREN}, {")", TokenKind::RPAREN},
+    {"{", TokenKind::LBRACE}, {"}", TokenKind::RBRACE},
+    {"[", TokenKind::LBRACKET}, {"]", TokenKind::RBRACKET},
+    {",", TokenKind::COMMA}, {";", TokenKind::SEMICOLON}, {":", TokenKind::COLON},
+    {"//", TokenKind::LINE_COMMENT}, {"/*", TokenKind::BLOCK_COMMENT},
+};
+
+constexpr std::array<uint8_t, 256> makeCharClasses() {
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 256; c++) {
+        uint8_t bits = 0;
+        bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        bool digit = c >= '0' && c <= '9';
+        if (c == ' ' || (c >= '\t' && c <= '\r')) bits |= CHAR_SPACE;
+        if (digit) bits |= CHAR_DIGIT;
+        if (letter) bits |= CHAR_LETTER;
+        if (letter || digit || c == '_') bits |= CHAR_IDENT;
+        if (digit || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) bits |= CHAR_HEX;
+        if (c > 127) bits |= CHAR_NON_ASCII;
+        table[c] = bits;
+    }
+    return table;
+}
+
+inline constexpr std::array<uint8_t, 256> charClasses = makeCharClasses();
+
+constexpr bool hasClass(char c, uint8_t bits) {
+    return (charClasses[static_cast<unsigned char>(c)] & bits) != 0;
+}
+
+constexpr std::array<StartAction, 256> makeStartActions() {
+    std::array<StartAction, 256> table{};
+    for (int c = 0; c < 256; c++) {
+        uint8_t bits = charClasses[c];
+        if (bits & CHAR_SPACE) table[c] = StartAction::Space;
+        else if (bits & CHAR_DIGIT) table[c] = StartAction::Number;
+        else if ((bits & CHAR_LETTER) || c == '_') table[c] = StartAction::Identifier;
+        else if (bits & CHAR_NON_ASCII) table[c] = StartAction::NonAscii;
+        else if (c == '"') table[c] = StartAction::String;
+        else if (c == '\'') table[c] = StartAction::Char;
+    }
+    for (const auto& spec : operatorSpecs) {
+        table[static_cast<unsigned char>(spec.spelling[0])] = StartAction::Operator;
+    }
+    return table;
+}
+
+inline constexpr std::array<StartAction, 256> startActions = makeStartActions();
+
+/* Operator DFA */
+
+constexpr size_t operatorStateCount() {
+    size_t states = 1;  // Start state
+    for (const auto& spec : operatorSpecs) {
+        for (const char* p = spec.spelling; *p; p++) states++;
+    }
+    return states;
+}
+
+struct OperatorDfa {
+    static constexpr size_t STATES = operatorStateCount();
+    static_assert(STATES < 256, "operator DFA states must fit in a byte");
+
+    // next[state][byte] is the following state, 0 when there is no transition
+    std::array<std::array<uint8_t, 256>, STATES> next{};
+    // Token accepted when the DFA stops in a state, UNKNOWN for pure prefixes
+    std::array<TokenKind, STATES> accept{};
+};
+
+constexpr OperatorDfa makeOperatorDfa() {
+    OperatorDfa dfa{};
+    for (auto& kind : dfa.accept) kind = TokenKind::UNKNOWN;
+    size_t used = 1;
+    for (const auto& spec : operatorSpecs) {
+        size_t state = 0;
+        for (const char* p = spec.spelling; *p; p++) {
+            auto byte = static_cast<unsigned char>(*p);
+            if (dfa.next[state][byte] == 0) {
+                dfa.next[state][byte] = static_cast<uint8_t>(used++);
+            }
+            state = dfa.next[state][byte];
+        }
+        dfa.accept[state] = spec.kind;
+    }
+    return dfa;
+}
+
+inline constexpr OperatorDfa operatorDfa = makeOperatorDfa();
+
+#endif //TC3002_COMPILER_CHARTABLES_H
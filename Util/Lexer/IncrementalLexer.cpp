@@ -0,0 +1,157 @@
+#include "IncrementalLexer.h"
+#include "Lexer.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+// Overwrites target[first, first + removed) with the replacement, growing or
+// shrinking the vector as needed
+template <typename T>
+static void splice(vector<T>& target, size_t first, size_t removed, const vector<T>& replacement) {
+    size_t overlap = min(removed, replacement.size());
+    copy(replacement.begin(), replacement.begin() + overlap, target.begin() + first);
+    if (replacement.size() > removed) {
+        target.insert(target.begin() + first + removed, replacement.begin() + overlap, replacement.end());
+    } else {
+        target.erase(target.begin() + first + overlap, target.begin() + first + removed);
+    }
+}
+
+IncrementalLexer::IncrementalLexer(string source) : text(std::move(source)) {
+    Lexer lexer(text, 0, 1, 1);
+    lexer.useInterner(symbols);
+    lexer.tokenize(tokenBuffer);
+}
+
+size_t IncrementalLexer::groupStart(size_t index) const {
+    const auto& kinds = tokenBuffer.kinds;
+    const auto& spans = tokenBuffer.spans;
+
+    size_t owner = index;
+    while (kinds[owner] == TokenKind::UNKNOWN) owner++;  // END_OF_FILE stops the walk
+    if (kinds[owner] != TokenKind::LIT_STR) return index;
+
+    uint32_t stringStart = spans[owner].offset;
+    uint32_t stringEnd = stringStart + spans[owner].length;
+    size_t first = owner;
+    while (first > 0 && kinds[first - 1] == TokenKind::UNKNOWN &&
+           spans[first - 1].offset > stringStart && spans[first - 1].offset < stringEnd) {
+        first--;
+    }
+    // An UNKNOWN before the group stands on its own
+    return index >= first ? first : index;
+}
+
+size_t IncrementalLexer::restartToken(size_t first) const {
+    // A group is lexed from its string's opening quote
+    size_t owner = first;
+    while (tokenBuffer.kinds[owner] == TokenKind::UNKNOWN) owner++;
+    if (tokenBuffer.kinds[owner] == TokenKind::LIT_STR &&
+        tokenBuffer.spans[owner].offset < tokenBuffer.spans[first].offset) {
+        return owner;
+    }
+    return first;
+}
+
+TokenEdit IncrementalLexer::relex(const TextEdit& edit) {
+    auto& kinds = tokenBuffer.kinds;
+    auto& spans = tokenBuffer.spans;
+    auto& locations = tokenBuffer.locations;
+    const size_t count = tokenBuffer.size();
+    const int64_t delta = static_cast<int64_t>(edit.replacement.size()) - edit.removedLength;
+    const uint64_t newEditEnd = static_cast<uint64_t>(edit.offset) + edit.replacement.size();
+
+    // First token ending at or after the edit. A token that ends exactly there
+    // may grow ("ab" + "c"); earlier ones cannot change, as the lexer never
+    // looks more than one character past a token. Token ends never decrease
+    // along the stream (queued UNKNOWNs lie inside their string), so a binary
+    // search finds it.
+    auto found = partition_point(spans.begin(), spans.end(), [&](const TokenSpan& span) {
+        return span.offset + span.length < edit.offset;
+    });
+    size_t first = groupStart(static_cast<size_t>(found - spans.begin()));
+    size_t restart = restartToken(first);
+
+    // The restart must not lie past the edit, where old offsets are stale.
+    // That happens when the edit is in the whitespace before the token; the
+    // token before it then ends ahead of the edit.
+    TokenLocation location = {1, 1};
+    uint32_t position = 0;
+    if (spans[restart].offset > edit.offset && first > 0) {
+        first = groupStart(first - 1);
+        restart = restartToken(first);
+    }
+    if (spans[restart].offset <= edit.offset) {
+        position = spans[restart].offset;
+        location = locations[restart];
+    } else {
+        first = 0;  // Edit in the leading whitespace, lex from the top
+    }
+
+    // Lex until a token past the edit has the same kind and length as an old
+    // token at the shifted offset. From there on both streams are the same
+    // characters lexed from the same state. END_OF_FILE always matches.
+    Lexer lexer(text, position, location.line, location.column);
+    lexer.useInterner(symbols);
+    TokenBuffer fresh;
+    size_t old = first;
+    size_t sync = count;
+    Token syncToken{};
+    while (true) {
+        Token token = lexer.next();
+        if (token.kind != TokenKind::UNKNOWN && token.offset >= newEditEnd) {
+            int64_t end = static_cast<int64_t>(token.offset) + token.length;
+            while (old < count && spans[old].offset + spans[old].length + delta < end) old++;
+            if (old < count && kinds[old] == token.kind && spans[old].length == token.length &&
+                spans[old].offset + delta == token.offset) {
+                sync = old;
+                syncToken = token;
+                break;
+            }
+        }
+        fresh.push(token);
+        if (token.kind == TokenKind::END_OF_FILE) break;
+    }
+
+    // Shift the kept tail. Columns only move on the line the resync token
+    // sits on; lines further down keep theirs.
+    if (sync < count) {
+        const uint32_t syncLine = locations[sync].line;
+        const int64_t lineDelta = static_cast<int64_t>(syncToken.line) - syncLine;
+        const int64_t columnDelta = static_cast<int64_t>(syncToken.column) - locations[sync].column;
+        for (size_t i = sync; i < count; i++) {
+            spans[i].offset = static_cast<uint32_t>(spans[i].offset + delta);
+            if (locations[i].line == syncLine) {
+                locations[i].column = static_cast<uint32_t>(locations[i].column + columnDelta);
+            }
+            locations[i].line = static_cast<uint32_t>(locations[i].line + lineDelta);
+        }
+    }
+
+    size_t removed = sync - first;
+    splice(kinds, first, removed, fresh.kinds);
+    splice(spans, first, removed, fresh.spans);
+    splice(locations, first, removed, fresh.locations);
+    splice(tokenBuffer.values, first, removed, fresh.values);
+    return {first, removed, fresh.size()};
+}
+
+TokenEdit IncrementalLexer::apply(const TextEdit& edit) {
+    if (edit.offset > text.size() || edit.removedLength > text.size() - edit.offset) {
+        throw runtime_error("Edit out of range");
+    }
+
+    // Copied first, the replacement may point into the text itself
+    string replacement(edit.replacement);
+    string removed = text.substr(edit.offset, edit.removedLength);
+    text.replace(edit.offset, edit.removedLength, replacement);
+    try {
+        return relex({edit.offset, edit.removedLength, replacement});
+    } catch (const runtime_error&) {
+        // Unterminated string, comment... the previous state stays valid
+        text.replace(edit.offset, replacement.size(), removed);
+        throw;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef TC3002_COMPILER_INCREMENTALLEXER_H
+#define TC3002_COMPILER_INCREMENTALLEXER_H
+
+#include "../../Token/TokenBuffer.h"
+#include "../Interner/Interner.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Replace `removedLength` bytes at `offset` with `replacement`
+struct TextEdit {
+    uint32_t offset;
+    uint32_t removedLength;
+    std::string_view replacement;
+};
+
+// Tokens [first, first + removedCount) of the old stream were replaced by
+// tokens [first, first + insertedCount) of the new one; everything after
+// them is the old stream, shifted
+struct TokenEdit {
+    size_t first;
+    size_t removedCount;
+    size_t insertedCount;
+};
+
+// Keeps a text and its token stream in step across edits. An edit is
+// re-lexed from the last token boundary before it until the new tokens line
+// up with the old ones again, so a keystroke costs a few tokens instead of a
+// whole-file tokenize. A string or block comment opened or closed by the
+// edit simply keeps the re-lex going until the streams agree again.
+class IncrementalLexer {
+private:
+    std::string text;
+    TokenBuffer tokenBuffer;
+    Interner symbols;  // Only ever grows, so IDs stay valid across edits
+
+    // First token of the group containing `index`: non-ASCII bytes in a
+    // string are reported as UNKNOWN tokens queued ahead of the LIT_STR, so
+    // lexing can only restart at the first of them
+    size_t groupStart(size_t index) const;
+    // Token whose start is where lexing resumes for the group at `first`
+    size_t restartToken(size_t first) const;
+    TokenEdit relex(const TextEdit& edit);
+
+public:
+    explicit IncrementalLexer(std::string source);
+
+    // Applies the edit to the text and updates the tokens. On a lexical error
+    // the text and tokens stay as they were before the edit.
+    TokenEdit apply(const TextEdit& edit);
+
+    const TokenBuffer& tokens() const { return tokenBuffer; }
+    std::string_view source() const { return text; }
+    const Interner& interner() const { return symbols; }
+};
+
+#endif //TC3002_COMPILER_INCREMENTALLEXER_H
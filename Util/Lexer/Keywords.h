@@ -0,0 +1,77 @@
+#ifndef TC3002_COMPILER_KEYWORDS_H
+#define TC3002_COMPILER_KEYWORDS_H
+
+#include "../../TokenKind/TokenKind.h"
+#include <string_view>
+
+// Maps an identifier to its keyword/API TokenKind, or IDENTIFIER.
+// Dispatches on length, then first (and where needed one more) character,
+// so every lookup ends in at most one string comparison and never allocates.
+constexpr TokenKind keywordKind(std::string_view s) {
+    auto is = [&s](std::string_view keyword, TokenKind kind) {
+        return s == keyword ? kind : TokenKind::IDENTIFIER;
+    };
+
+    switch (s.size()) {
+        case 2:
+            switch (s[0]) {
+                case 'i': return is("if", TokenKind::IF);
+                case 'o': return is("or", TokenKind::OR);
+            }
+            break;
+        case 3:
+            switch (s[0]) {
+                case 'a': return s[1] == 'n' ? is("and", TokenKind::AND) : is("add", TokenKind::ADD);
+                case 'd': return is("dec", TokenKind::DEC);
+                case 'g': return is("get", TokenKind::GET);
+                case 'i': return is("inc", TokenKind::INC);
+                case 'n': return s[2] == 't' ? is("not", TokenKind::NOT) : is("new", TokenKind::NEW);
+                case 's': return is("set", TokenKind::SET);
+                case 'v': return is("var", TokenKind::VAR);
+            }
+            break;
+        case 4:
+            switch (s[0]) {
+                case 'e': return s[1] == 'l' && s[2] == 'i' ? is("elif", TokenKind::ELIF)
+                                                            : is("else", TokenKind::ELSE);
+                case 'l': return is("loop", TokenKind::LOOP);
+                case 'm': return is("main", TokenKind::MAIN);
+                case 's': return is("size", TokenKind::SIZE);
+                case 't': return is("true", TokenKind::LIT_BOOL);
+            }
+            break;
+        case 5:
+            switch (s[0]) {
+                case 'b': return is("break", TokenKind::BREAK);
+                case 'f': return is("false", TokenKind::LIT_BOOL);
+                case 'r': return s[4] == 'i' ? is("readi", TokenKind::READI) : is("reads", TokenKind::READS);
+            }
+            break;
+        case 6:
+            switch (s[0]) {
+                case 'r': return is("return", TokenKind::RETURN);
+                case 'p':
+                    switch (s[5]) {
+                        case 'i': return is("printi", TokenKind::PRINTI);
+                        case 'c': return is("printc", TokenKind::PRINTC);
+                        case 's': return is("prints", TokenKind::PRINTS);
+                    }
+                    break;
+            }
+            break;
+        case 7:
+            return is("println", TokenKind::PRINTLN);
+    }
+    return TokenKind::IDENTIFIER;
+}
+
+static_assert(keywordKind("and") == TokenKind::AND, "keyword table out of sync");
+static_assert(keywordKind("add") == TokenKind::ADD, "keyword table out of sync");
+static_assert(keywordKind("elif") == TokenKind::ELIF, "keyword table out of sync");
+static_assert(keywordKind("else") == TokenKind::ELSE, "keyword table out of sync");
+static_assert(keywordKind("false") == TokenKind::LIT_BOOL, "keyword table out of sync");
+static_assert(keywordKind("prints") == TokenKind::PRINTS, "keyword table out of sync");
+static_assert(keywordKind("printx") == TokenKind::IDENTIFIER, "keyword table out of sync");
+static_assert(keywordKind("main_loop") == TokenKind::IDENTIFIER, "keyword table out of sync");
+
+#endif //TC3002_COMPILER_KEYWORDS_H
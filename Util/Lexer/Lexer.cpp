@@ -1,24 +1,29 @@
-#include "lexer.h"
-#include <cctype>
+#include "Lexer.h"
+#include "CharTables.h"
+#include "Keywords.h"
+#include "SimdScan.h"
 #include <unordered_map>
 #include <stdexcept>
 #include <iostream>
+#include <cstdint>
 
-const unordered_set<string> Lexer::keywords = {
-    "and", "break", "dec", "elif", "else", "false", "if", "inc",
-    "loop", "not", "or", "return", "true", "var",
-    // API Functions
-    "printi", "printc", "prints", "println",
-    "readi", "reads",
-    "new", "size", "add", "get", "set",
-    "main"
-};
-
-Lexer::Lexer(const string& source) : source(source) {}
-
-bool isSpecialChar(char c) {
-    // Check for non-ASCII characters
-    return static_cast<unsigned char>(c) > 127;
+static void checkSourceSize(size_t size) {
+    if (size > UINT32_MAX) {
+        throw runtime_error("Source file too large (4 GiB limit)");
+    }
+}
+
+Lexer::Lexer(const string& source) : ownedSource(source), source(ownedSource) {
+    checkSourceSize(ownedSource.size());
+}
+
+Lexer::Lexer(const SourceBuffer& buffer) : source(buffer.view()) {
+    checkSourceSize(buffer.size());
+}
+
+Lexer::Lexer(string_view source, size_t position, size_t line, size_t column)
+    : source(source), position(position), line(line), column(column) {
+    checkSourceSize(source.size());
 }
 
 
@@ -41,104 +46,110 @@ void Lexer::advance() {
     position++;
 }
 
-bool isLatinLetter(char c) {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+void Lexer::advanceTo(size_t end) {
+    // Bulk version of advance(): newlines are counted rather than stepped over
+    size_t newlines = scan.countNewlines(source.data(), position, end);
+    if (newlines == 0) {
+        column += end - position;
+    } else {
+        size_t lastNewline = end - 1;
+        while (source[lastNewline] != '\n') lastNewline--;
+        line += newlines;
+        column = end - lastNewline;
+    }
+    position = end;
+}
+
+void Lexer::advanceWithinLine(size_t end) {
+    column += end - position;
+    position = end;
 }
 
 void Lexer::skipWhitespace() {
-    while (position < source.length()) {
-        char c = currentChar();
-        if (c == '\n') {
-            line++;
-            column = 1;
-            position++;
-        } else if (isspace(c)) {
-            advance();
-        } else {
-            break;
-        }
-    }
+    advanceTo(scan.whitespace(source.data(), position, source.length()));
+}
+
+Token Lexer::makeToken(TokenKind kind, size_t start, size_t startLine, size_t startColumn) const {
+    return {kind, static_cast<uint32_t>(start), static_cast<uint32_t>(position - start),
+            startLine, startColumn, 0};
 }
 
 Token Lexer::readNumber() {
+    size_t start = position;
     size_t startLine = line;
     size_t startColumn = column;
-    string numStr;
+    bool negative = false;
 
     if (currentChar() == '-') {
-        numStr += '-';
+        negative = true;
         advance();
     }
 
-    while (isdigit(currentChar())) {
-        numStr += currentChar();
+    // Accumulate the magnitude once, rejecting anything outside int64_t
+    const uint64_t limit = negative ? uint64_t(INT64_MAX) + 1 : uint64_t(INT64_MAX);
+    uint64_t magnitude = 0;
+    while (hasClass(currentChar(), CHAR_DIGIT)) {
+        uint64_t digit = currentChar() - '0';
+        if (magnitude > (limit - digit) / 10) {
+            throw runtime_error("[Line " + to_string(startLine) + ":" + to_string(startColumn)
+                                + "] Integer literal out of range");
+        }
+        magnitude = magnitude * 10 + digit;
         advance();
     }
 
-    return {TokenKind::LIT_INT, numStr, startLine, startColumn};
+    Token token = makeToken(TokenKind::LIT_INT, start, startLine, startColumn);
+    if (negative) {
+        token.intValue = magnitude == limit ? INT64_MIN : -static_cast<int64_t>(magnitude);
+    } else {
+        token.intValue = static_cast<int64_t>(magnitude);
+    }
+    return token;
 }
 
 Token Lexer::readIdentifier() {
+    size_t start = position;
     size_t startLine = line;
     size_t startColumn = column;
-    string ident;
 
     // First character must be a letter or underscore
-    if (isLatinLetter(currentChar()) || currentChar() == '_') {
-        ident += currentChar();
+    if (hasClass(currentChar(), CHAR_LETTER) || currentChar() == '_') {
         advance();
     } else {
         // Handle as unknown character
-        return {TokenKind::UNKNOWN, string(1, currentChar()), startLine, startColumn};
+        advance();
+        return makeToken(TokenKind::UNKNOWN, start, startLine, startColumn);
     }
 
     // Subsequent characters can be letters, digits or underscores
-    while (isLatinLetter(currentChar()) || isdigit(currentChar()) || currentChar() == '_') {
-        ident += currentChar();
-        advance();
-    }
+    advanceWithinLine(scan.identifier(source.data(), position, source.length()));
 
-    // Check if it's a keyword
-    if (keywords.count(ident)) {
-        if (ident == "true" || ident == "false") {
-            return {TokenKind::LIT_BOOL, ident, startLine, startColumn};
-        }
-        return {TokenKindFromString(ident), ident, startLine, startColumn};
+    // Keywords, API names and boolean literals resolve in a single probe
+    string_view ident(source.data() + start, position - start);
+    Token token = makeToken(keywordKind(ident), start, startLine, startColumn);
+    if (interner && (token.kind == TokenKind::IDENTIFIER || token.kind == TokenKind::MAIN)) {
+        token.intValue = interner->intern(ident);
     }
-    return {TokenKind::IDENTIFIER, ident, startLine, startColumn};
+    return token;
 }
 
 Token Lexer::readString() {
+    size_t start = position;
     size_t startLine = line;
     size_t startColumn = column;
-    string str;
     advance(); // Skip opening quote
 
-    while (currentChar() != '"' && currentChar() != '\n') {
+    while (true) {
+        // Plain characters are skipped in bulk, stopping at anything special
+        advanceWithinLine(scan.stringBody(source.data(), position, source.length()));
+        if (position >= source.length() || currentChar() == '"' || currentChar() == '\n') {
+            break;
+        }
         if (currentChar() == '\\') {
-            advance(); // Skip backslash
-            switch (currentChar()) {
-                case 'n': str += '\n'; break;
-                case 'r': str += '\r'; break;
-                case 't': str += '\t'; break;
-                case '\\': str += '\\'; break;
-                case '"': str += '"'; break;
-                case '\'': str += '\''; break;
-                case 'u': // Unicode escape
-                    // Handle unicode escape sequence
-                    break;
-                default:
-                    str += '\\';
-                    str += currentChar();
-            }
-        } else if (isSpecialChar(currentChar())) {
+            advance(); // Skip backslash, the escaped character is skipped below
+        } else if (hasClass(currentChar(), CHAR_NON_ASCII)) {
             // Mark special characters in strings as unknown
-            str += currentChar();
-            tokens.push_back({TokenKind::UNKNOWN, string(1, currentChar()), line, column});
-            advance();
-            continue;
-        } else {
-            str += currentChar();
+            pending.push_back({TokenKind::UNKNOWN, static_cast<uint32_t>(position), 1, line, column, 0});
         }
         advance();
     }
@@ -148,53 +159,40 @@ Token Lexer::readString() {
     }
     advance(); // Skip closing quote
 
-    return {TokenKind::LIT_STR, str, startLine, startColumn};
+    return makeToken(TokenKind::LIT_STR, start, startLine, startColumn);
 }
 
 Token Lexer::readChar() {
+    size_t start = position;
     size_t startLine = line;
     size_t startColumn = column;
-    string ch;
     advance(); // Skip opening quote
 
     if (currentChar() == '\\') {
         advance(); // Skip backslash
-        switch (currentChar()) {
-            case 'n': ch = "\n"; break;
-            case 'r': ch = "\r"; break;
-            case 't': ch = "\t"; break;
-            case '\\': ch = "\\"; break;
-            case '"': ch = "\""; break;
-            case '\'': ch = "'"; break;
-            case 'u': // Unicode escape
-
-                break;
-            default:
-                ch = "\\";
-                ch += currentChar();
-        }
-        advance();
-    } else {
-        if (currentChar() == '\'') {
-            throw runtime_error("Empty character literal");
+        if (currentChar() == 'u') {
+            // Unicode escape: up to six hex digits
+            advance();
+            for (int i = 0; i < 6 && hasClass(currentChar(), CHAR_HEX); i++) {
+                advance();
+            }
+        } else {
+            advance();
         }
-        ch = currentChar();
-        advance();
-    }
-
-     if (currentChar() == '\'') {
+    } else if (currentChar() == '\'') {
         throw runtime_error("Empty character literal");
-    }
-
-    // Detect special characters
-    if (static_cast<unsigned char>(currentChar()) > 127) {
-        ch = currentChar();
-        advance();
+    } else if (hasClass(currentChar(), CHAR_NON_ASCII)) {
+        // Detect special characters: the whole multi-byte sequence is unknown
+        while (hasClass(currentChar(), CHAR_NON_ASCII)) {
+            advance();
+        }
         if (currentChar() != '\'') {
             throw runtime_error("Unterminated character literal");
         }
         advance();
-        return {TokenKind::UNKNOWN, ch, startLine, startColumn};
+        return makeToken(TokenKind::UNKNOWN, start, startLine, startColumn);
+    } else {
+        advance();
     }
 
     if (currentChar() != '\'') {
@@ -202,231 +200,224 @@ Token Lexer::readChar() {
     }
     advance(); // Skip closing quote
 
-    return {TokenKind::LIT_CHAR, ch, startLine, startColumn};
+    return makeToken(TokenKind::LIT_CHAR, start, startLine, startColumn);
 }
 
 Token Lexer::readLineComment() {
+    size_t start = position;
     size_t startLine = line;
     size_t startColumn = column;
-    string comment;
     advance(); advance(); // Skip initial //
 
-    while (currentChar() != '\n' && currentChar() != '\0') {
-        comment += currentChar();
-        advance();
-    }
+    advanceWithinLine(scan.lineComment(source.data(), position, source.length()));
 
-    // // cout << "Detected LINE_COMMENT: " << comment << endl;
-    return {TokenKind::LINE_COMMENT, comment, startLine, startColumn};
+    return makeToken(TokenKind::LINE_COMMENT, start, startLine, startColumn);
 }
 
 Token Lexer::readBlockComment() {
+    size_t start = position;
     size_t startLine = line;
     size_t startColumn = column;
-    string comment;
 
     // Skip /*
     advance(); advance();
 
-    while (position < source.length()) {
-        if (currentChar() == '*' && peekChar() == '/') {
-            advance(); advance();
-            // Return with original starting line
-            return {TokenKind::BLOCK_COMMENT, comment, startLine, startColumn};
-        }
-        comment += currentChar();
-        advance();
+    size_t end = scan.blockComment(source.data(), position, source.length());
+    advanceTo(end);
+    if (end < source.length()) {
+        advance(); advance();
+        // Return with original starting line
+        return makeToken(TokenKind::BLOCK_COMMENT, start, startLine, startColumn);
     }
     throw runtime_error("Unterminated block comment");
 }
 
-TokenKind Lexer::TokenKindFromString(const string& str) {
-    static const unordered_map<string, TokenKind> keywordMap = {
-        {"and", TokenKind::AND}, {"break", TokenKind::BREAK},
-        {"dec", TokenKind::DEC}, {"elif", TokenKind::ELIF},
-        {"else", TokenKind::ELSE}, {"false", TokenKind::FALSE},
-        {"if", TokenKind::IF}, {"inc", TokenKind::INC},
-        {"loop", TokenKind::LOOP}, {"not", TokenKind::NOT},
-        {"or", TokenKind::OR}, {"return", TokenKind::RETURN},
-        {"true", TokenKind::TRUE}, {"var", TokenKind::VAR},
-         // API Functions
-        {"printi", TokenKind::PRINTI},
-        {"printc", TokenKind::PRINTC},
-        {"prints", TokenKind::PRINTS},
-        {"println", TokenKind::PRINTLN},
-        {"readi", TokenKind::READI},
-        {"reads", TokenKind::READS},
-        {"new", TokenKind::NEW},
-        {"size", TokenKind::SIZE},
-        {"add", TokenKind::ADD},
-        {"get", TokenKind::GET},
-        {"set", TokenKind::SET},
-        {"main", TokenKind::MAIN},
-         // Boolean literals
-        {"true", TokenKind::LIT_BOOL},
-        {"false", TokenKind::LIT_BOOL}
-    };
-    auto it = keywordMap.find(str);
-    return it != keywordMap.end() ? it->second : TokenKind::IDENTIFIER;
-}
-
-vector<Token> Lexer::tokenize() {
+Token Lexer::scanToken() {
     while (position < source.length()) {
         char c = currentChar();
+        size_t start = position;
+        size_t startLine = line;
+        size_t startColumn = column;
 
-        if (isspace(c)) {
-            skipWhitespace();
-            continue;
+        switch (startActions[static_cast<unsigned char>(c)]) {
+            case StartAction::Space:
+                skipWhitespace();
+                continue;
+            case StartAction::Identifier:
+                return readIdentifier();
+            case StartAction::Number:
+                return readNumber();
+            case StartAction::String:
+                return readString();
+            case StartAction::Char:
+                return readChar();
+            case StartAction::Operator:
+                if (c == '-' && hasClass(peekChar(), CHAR_DIGIT)) {
+                    return readNumber();
+                }
+                return readOperator();
+            case StartAction::NonAscii:
+            case StartAction::Unknown:
+                advance();
+                return makeToken(TokenKind::UNKNOWN, start, startLine, startColumn);
         }
+    }
 
-         if (static_cast<unsigned char>(c) > 127) {
-            tokens.push_back({TokenKind::UNKNOWN, string(1, c), line, column});
-            advance();
-            continue;
-        }
+    return makeToken(TokenKind::END_OF_FILE, position, line, column);
+}
 
-        // Handle // comments
-        if (c == '/' && peekChar() == '/') {
-            tokens.push_back(readLineComment());
-            continue;
-        }
+Token Lexer::readOperator() {
+    size_t start = position;
+    size_t startLine = line;
+    size_t startColumn = column;
 
-        // Handle /* comments
-        if (c == '/' && peekChar() == '*') {
-            // cout << "Block comment detected at " << line << ":" << column << endl;
-            tokens.push_back(readBlockComment());
-            continue;
+    // Longest match through the operator DFA
+    uint8_t state = 0;
+    size_t length = 0;
+    size_t acceptedLength = 0;
+    TokenKind accepted = TokenKind::UNKNOWN;
+    while (start + length < source.length()) {
+        uint8_t nextState = operatorDfa.next[state][static_cast<unsigned char>(source[start + length])];
+        if (nextState == 0) break;
+        state = nextState;
+        length++;
+        if (operatorDfa.accept[state] != TokenKind::UNKNOWN) {
+            accepted = operatorDfa.accept[state];
+            acceptedLength = length;
         }
+    }
 
-        if (isdigit(c) || (c == '-' && isdigit(peekChar()))) {
-            tokens.push_back(readNumber());
-            continue;
-        }
+    switch (accepted) {
+        case TokenKind::LINE_COMMENT:
+            return readLineComment();
+        case TokenKind::BLOCK_COMMENT:
+            return readBlockComment();
+        case TokenKind::UNKNOWN:
+            // A bare prefix such as '!' is reported one character at a time
+            advance();
+            return makeToken(TokenKind::UNKNOWN, start, startLine, startColumn);
+        default:
+            advanceWithinLine(start + acceptedLength);
+            return makeToken(accepted, start, startLine, startColumn);
+    }
+}
 
-        if (isalpha(c) || c == '_') {
-            tokens.push_back(readIdentifier());
-            continue;
-        }
+Token Lexer::next() {
+    // Tokens found while scanning a string literal are queued ahead of it
+    if (pendingIndex < pending.size()) {
+        return pending[pendingIndex++];
+    }
+    pending.clear();
+    pendingIndex = 0;
+
+    Token token = scanToken();
+    if (!pending.empty()) {
+        pending.push_back(token);
+        return pending[pendingIndex++];
+    }
+    return token;
+}
 
-        if (c == '"') {
-            tokens.push_back(readString());
-            continue;
+vector<Token> Lexer::tokenize() {
+    vector<Token> tokens;
+    // Rough density guess so the token array grows only a handful of times
+    tokens.reserve(source.length() / 8 + 1);
+
+    while (true) {
+        tokens.push_back(next());
+        if (tokens.back().kind == TokenKind::END_OF_FILE) {
+            return tokens;
         }
+    }
+}
 
-        if (c == '\'') {
-            tokens.push_back(readChar());
-            continue;
+void Lexer::tokenize(TokenBuffer& out) {
+    out.reserve(out.size() + source.length() / 8 + 1);
+    while (true) {
+        Token token = next();
+        out.push(token);
+        if (token.kind == TokenKind::END_OF_FILE) {
+            return;
         }
+    }
+}
 
-        // Handle operators
-        switch (c) {
-            case '=':
-                if (peekChar() == '=') {
-                    advance(); advance();
-                    tokens.push_back({TokenKind::EQUAL, "==", line, column-1});
-                } else {
-                    advance();
-                    tokens.push_back({TokenKind::ASSIGN, "=", line, column-1});
-                }
-                continue;
-            case '!':
-                if (peekChar() == '=') {
-                    advance(); advance();
-                    tokens.push_back({TokenKind::NOT_EQUAL, "!=", line, column-1});
-                } else {
-                    advance();
-                    tokens.push_back({TokenKind::UNKNOWN, "!", line, column-1});
-                }
-                continue;
-            case '<':
-                if (peekChar() == '=') {
-                    advance(); advance();
-                    tokens.push_back({TokenKind::LESS_EQUAL, "<=", line, column-1});
-                } else {
-                    advance();
-                    tokens.push_back({TokenKind::LESS, "<", line, column-1});
-                }
-                continue;
-            case '>':
-                if (peekChar() == '=') {
-                    advance(); advance();
-                    tokens.push_back({TokenKind::GREATER_EQUAL, ">=", line, column-1});
-                } else {
-                    advance();
-                    tokens.push_back({TokenKind::GREATER, ">", line, column-1});
-                }
-                continue;
-            case '+':
-                advance();
-                tokens.push_back({TokenKind::PLUS, "+", line, column-1});
-                continue;
-            case '-':
-                advance();
-                tokens.push_back({TokenKind::MINUS, "-", line, column-1});
-                continue;
-            case '*':
-                advance();
-                tokens.push_back({TokenKind::ASTERISK, "*", line, column-1});
-                continue;
-            case '/':
-                if (peekChar() == '/') {
-                    tokens.push_back(readLineComment());
-                    continue;
-                } else if (peekChar() == '*') {
-                    tokens.push_back(readBlockComment());
-                    continue;
+string_view Lexer::text(const Token& token) const {
+    return tokenText(token, source);
+}
+
+static int32_t hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return c - 'A' + 10;
+}
+
+// Decodes the code point starting at body[i] and moves i past it
+static int32_t decodeCodePoint(string_view body, size_t& i) {
+    unsigned char c = body[i++];
+    if (c == '\\' && i < body.size()) {
+        switch (body[i++]) {
+            case 'n': return '\n';
+            case 'r': return '\r';
+            case 't': return '\t';
+            case '\\': return '\\';
+            case '"': return '"';
+            case '\'': return '\'';
+            case 'u': { // Unicode escape: up to six hex digits
+                int32_t codePoint = 0;
+                for (int n = 0; n < 6 && i < body.size() && hasClass(body[i], CHAR_HEX); n++, i++) {
+                    codePoint = codePoint * 16 + hexValue(body[i]);
                 }
-                advance();
-                tokens.push_back({TokenKind::SLASH, "/", line, column-1});
-                continue;
-            case '%':
-                advance();
-                tokens.push_back({TokenKind::PERCENT, "%", line, column-1});
-                continue;
-            case '(':
-                advance();
-                tokens.push_back({TokenKind::LPAREN, "(", line, column-1});
-                continue;
-            case ')':
-                advance();
-                tokens.push_back({TokenKind::RPAREN, ")", line, column-1});
-                continue;
-            case '{':
-                advance();
-                tokens.push_back({TokenKind::LBRACE, "{", line, column-1});
-                continue;
-            case '}':
-                advance();
-                tokens.push_back({TokenKind::RBRACE, "}", line, column-1});
-                continue;
-            case '[':
-                advance();
-                tokens.push_back({TokenKind::LBRACKET, "[", line, column-1});
-                continue;
-            case ']':
-                advance();
-                tokens.push_back({TokenKind::RBRACKET, "]", line, column-1});
-                continue;
-            case ',':
-                advance();
-                tokens.push_back({TokenKind::COMMA, ",", line, column-1});
-                continue;
-            case ';':
-                advance();
-                tokens.push_back({TokenKind::SEMICOLON, ";", line, column-1});
-                continue;
-            case ':':
-                advance();
-                tokens.push_back({TokenKind::COLON, ":", line, column-1});
-                continue;
+                return codePoint;
+            }
             default:
-                advance();
-                tokens.push_back({TokenKind::UNKNOWN, string(1, c), line, column-1});
+                // Unknown escapes keep their backslash
+                i--;
+                return '\\';
         }
     }
+    if (c < 0xC0) {
+        return c;
+    }
+    // Multi-byte UTF-8 sequence, malformed input falls back to the raw byte
+    size_t extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : 1;
+    if (i + extra > body.size()) {
+        return c;
+    }
+    int32_t codePoint = c & (0x3F >> extra);
+    for (size_t n = 0; n < extra; n++) {
+        unsigned char next = body[i + n];
+        if ((next & 0xC0) != 0x80) {
+            return c;
+        }
+        codePoint = (codePoint << 6) | (next & 0x3F);
+    }
+    i += extra;
+    return codePoint;
+}
+
+// Strips the surrounding quotes of a string or character lexeme
+static string_view literalBody(string_view lexeme) {
+    if (lexeme.size() < 2) {
+        return {};
+    }
+    return lexeme.substr(1, lexeme.size() - 2);
+}
+
+vector<int32_t> Lexer::decodeString(string_view lexeme) {
+    string_view body = literalBody(lexeme);
+    vector<int32_t> codePoints;
+    codePoints.reserve(body.size());
+    for (size_t i = 0; i < body.size();) {
+        codePoints.push_back(decodeCodePoint(body, i));
+    }
+    return codePoints;
+}
 
-    tokens.push_back({TokenKind::END_OF_FILE, "", line, column});
-    return tokens;
+int32_t Lexer::decodeChar(string_view lexeme) {
+    string_view body = literalBody(lexeme);
+    size_t i = 0;
+    return body.empty() ? 0 : decodeCodePoint(body, i);
 }
 
 string Lexer::tokenKindToString(TokenKind kind) {
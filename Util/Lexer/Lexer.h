@@ -2,38 +2,69 @@
 #define LEXER_H
 
 #include "../../Token/Token.h"
+#include "../../Token/TokenBuffer.h"
+#include "../SourceBuffer/SourceBuffer.h"
+#include "../Interner/Interner.h"
+#include "SimdScan.h"
 #include <vector>
 #include <string>
-#include <unordered_set>
+#include <string_view>
 
 class Lexer {
 private:
-    string source;
+    string ownedSource;   // Only used when constructed from a string
+    string_view source;   // The text being lexed, owned or borrowed
     size_t position = 0;
     size_t line = 1;
     size_t column = 1;
-    vector<Token> tokens;
-
-    static const unordered_set<string> keywords;
+    vector<Token> pending;   // Queued tokens to hand out before scanning on
+    size_t pendingIndex = 0;
+    const ScanFunctions& scan = scanFunctions();
+    Interner* interner = nullptr;  // Owned by the compilation session
 
     char currentChar() const;
     char peekChar() const;
     void advance();
+    void advanceTo(size_t end);
+    void advanceWithinLine(size_t end);
     void skipWhitespace();
     void skipLineComment();
     void skipBlockComment();
+    Token makeToken(TokenKind kind, size_t start, size_t startLine, size_t startColumn) const;
     Token readLineComment();
     Token readBlockComment();
     Token readNumber();
     Token readIdentifier();
     Token readString();
     Token readChar();
-    TokenKind TokenKindFromString(const string& str);
-    
+    Token readOperator();
+    Token scanToken();
+
 public:
     Lexer(const string& source);
+    // Borrows the buffer, which must outlive the Lexer and its tokens
+    Lexer(const SourceBuffer& buffer);
+    // Borrows the text and starts at a token boundary other than the
+    // beginning, which is how the incremental lexer resumes after an edit
+    Lexer(string_view source, size_t position, size_t line, size_t column);
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
+    // Identifiers (and 'main') lexed from now on carry their symbol ID in intValue
+    void useInterner(Interner& symbols) { interner = &symbols; }
+    // Pull interface: returns the next token, END_OF_FILE once exhausted
+    Token next();
     vector<Token> tokenize();
+    // Same stream, written straight into structure-of-arrays storage
+    void tokenize(TokenBuffer& out);
     static string tokenKindToString(TokenKind kind);
+
+    string_view sourceText() const { return source; }
+    // Raw lexeme of a token, as a view into the source
+    string_view text(const Token& token) const;
+
+    // Lazy literal decoding: escape sequences are only resolved on request
+    static vector<int32_t> decodeString(string_view lexeme);
+    static int32_t decodeChar(string_view lexeme);
 };
 
-#endif
\ No newline at end of file
+#endif
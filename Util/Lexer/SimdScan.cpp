@@ -0,0 +1,217 @@
+#include "SimdScan.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define QUETZAL_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/* Scalar implementations, also used for the tails of the vector loops */
+
+static inline bool isSpaceByte(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool isIdentByte(unsigned char c) {
+    return static_cast<unsigned char>((c | 0x20) - 'a') < 26
+        || static_cast<unsigned char>(c - '0') < 10
+        || c == '_';
+}
+
+static size_t whitespaceScalar(const char* data, size_t i, size_t end) {
+    while (i < end && isSpaceByte(data[i])) i++;
+    return i;
+}
+
+static size_t identifierScalar(const char* data, size_t i, size_t end) {
+    while (i < end && isIdentByte(data[i])) i++;
+    return i;
+}
+
+static size_t lineCommentScalar(const char* data, size_t i, size_t end) {
+    while (i < end && data[i] != '\n' && data[i] != '\0') i++;
+    return i;
+}
+
+static size_t blockCommentScalar(const char* data, size_t i, size_t end) {
+    for (; i + 1 < end; i++) {
+        if (data[i] == '*' && data[i + 1] == '/') return i;
+    }
+    return end;
+}
+
+static size_t stringBodyScalar(const char* data, size_t i, size_t end) {
+    for (; i < end; i++) {
+        unsigned char c = data[i];
+        if (c == '"' || c == '\\' || c == '\n' || c > 127) return i;
+    }
+    return end;
+}
+
+static size_t countNewlinesScalar(const char* data, size_t i, size_t end) {
+    size_t count = 0;
+    for (; i < end; i++) count += data[i] == '\n';
+    return count;
+}
+
+#ifdef QUETZAL_SIMD_X86
+
+/* SSE2: 16 bytes per step. Each *Mask16 helper flags the bytes ending a run. */
+
+static inline __m128i whitespaceMask16(__m128i x) {
+    // ' ' or '\t'..'\r', the latter as an unsigned range check on x - '\t'
+    __m128i shifted = _mm_sub_epi8(x, _mm_set1_epi8('\t'));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+    __m128i space = _mm_or_si128(control, _mm_cmpeq_epi8(x, _mm_set1_epi8(' ')));
+    return _mm_xor_si128(space, _mm_set1_epi8(-1));
+}
+
+static inline __m128i identifierMask16(__m128i x) {
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(x, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(25)), letter);
+    __m128i digit = _mm_sub_epi8(x, _mm_set1_epi8('0'));
+    __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i ident = _mm_or_si128(_mm_or_si128(isLetter, isDigit), _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+    return _mm_xor_si128(ident, _mm_set1_epi8(-1));
+}
+
+static inline __m128i lineCommentMask16(__m128i x) {
+    return _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(x, _mm_setzero_si128()));
+}
+
+static inline __m128i stringBodyMask16(__m128i x) {
+    __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\')));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(x, _mm_set1_epi8('\n')));
+    // Non-ASCII bytes are negative as signed chars
+    return _mm_or_si128(stop, _mm_cmplt_epi8(x, _mm_setzero_si128()));
+}
+
+#define QUETZAL_SSE2_FIND(name, maskFunction, scalar)                          \
+    static size_t name(const char* data, size_t i, size_t end) {                \
+        for (; i + 16 <= end; i += 16) {                                        \
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)); \
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(maskFunction(x))); \
+            if (mask) return i + __builtin_ctz(mask);                           \
+        }                                                                       \
+        return scalar(data, i, end);                                            \
+    }
+
+QUETZAL_SSE2_FIND(whitespaceSse2, whitespaceMask16, whitespaceScalar)
+QUETZAL_SSE2_FIND(identifierSse2, identifierMask16, identifierScalar)
+QUETZAL_SSE2_FIND(lineCommentSse2, lineCommentMask16, lineCommentScalar)
+QUETZAL_SSE2_FIND(stringBodySse2, stringBodyMask16, stringBodyScalar)
+
+static size_t blockCommentSse2(const char* data, size_t i, size_t end) {
+    // Compare "*" at i and "/" at i + 1 with two overlapping loads
+    for (; i + 17 <= end; i += 16) {
+        __m128i star = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)),
+                                      _mm_set1_epi8('*'));
+        __m128i slash = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1)),
+                                       _mm_set1_epi8('/'));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(star, slash)));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return blockCommentScalar(data, i, end);
+}
+
+static size_t countNewlinesSse2(const char* data, size_t i, size_t end) {
+    size_t count = 0;
+    for (; i + 16 <= end; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        count += __builtin_popcount(static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')))));
+    }
+    return count + countNewlinesScalar(data, i, end);
+}
+
+/* AVX2: the same classifiers on 32 bytes per step */
+
+#define QUETZAL_AVX2 __attribute__((target("avx2")))
+
+QUETZAL_AVX2 static inline __m256i whitespaceMask32(__m256i x) {
+    __m256i shifted = _mm256_sub_epi8(x, _mm256_set1_epi8('\t'));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+    __m256i space = _mm256_or_si256(control, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')));
+    return _mm256_xor_si256(space, _mm256_set1_epi8(-1));
+}
+
+QUETZAL_AVX2 static inline __m256i identifierMask32(__m256i x) {
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(25)), letter);
+    __m256i digit = _mm256_sub_epi8(x, _mm256_set1_epi8('0'));
+    __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i ident = _mm256_or_si256(_mm256_or_si256(isLetter, isDigit),
+                                    _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')));
+    return _mm256_xor_si256(ident, _mm256_set1_epi8(-1));
+}
+
+QUETZAL_AVX2 static inline __m256i lineCommentMask32(__m256i x) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')),
+                           _mm256_cmpeq_epi8(x, _mm256_setzero_si256()));
+}
+
+QUETZAL_AVX2 static inline __m256i stringBodyMask32(__m256i x) {
+    __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('"')),
+                                   _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\')));
+    stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')));
+    return _mm256_or_si256(stop, _mm256_cmpgt_epi8(_mm256_setzero_si256(), x));
+}
+
+#define QUETZAL_AVX2_FIND(name, maskFunction, sse2)                            \
+    QUETZAL_AVX2 static size_t name(const char* data, size_t i, size_t end) {  \
+        for (; i + 32 <= end; i += 32) {                                        \
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)); \
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(maskFunction(x))); \
+            if (mask) return i + __builtin_ctz(mask);                           \
+        }                                                                       \
+        return sse2(data, i, end);                                              \
+    }
+
+QUETZAL_AVX2_FIND(whitespaceAvx2, whitespaceMask32, whitespaceSse2)
+QUETZAL_AVX2_FIND(identifierAvx2, identifierMask32, identifierSse2)
+QUETZAL_AVX2_FIND(lineCommentAvx2, lineCommentMask32, lineCommentSse2)
+QUETZAL_AVX2_FIND(stringBodyAvx2, stringBodyMask32, stringBodySse2)
+
+QUETZAL_AVX2 static size_t blockCommentAvx2(const char* data, size_t i, size_t end) {
+    for (; i + 33 <= end; i += 32) {
+        __m256i star = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)),
+                                         _mm256_set1_epi8('*'));
+        __m256i slash = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1)),
+                                          _mm256_set1_epi8('/'));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(star, slash)));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return blockCommentSse2(data, i, end);
+}
+
+QUETZAL_AVX2 static size_t countNewlinesAvx2(const char* data, size_t i, size_t end) {
+    size_t count = 0;
+    for (; i + 32 <= end; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        count += __builtin_popcount(static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')))));
+    }
+    return count + countNewlinesSse2(data, i, end);
+}
+
+#endif // QUETZAL_SIMD_X86
+
+static ScanFunctions selectScanFunctions() {
+#ifdef QUETZAL_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {whitespaceAvx2, identifierAvx2, lineCommentAvx2,
+                blockCommentAvx2, stringBodyAvx2, countNewlinesAvx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return {whitespaceSse2, identifierSse2, lineCommentSse2,
+                blockCommentSse2, stringBodySse2, countNewlinesSse2, "sse2"};
+    }
+#endif
+    return {whitespaceScalar, identifierScalar, lineCommentScalar,
+            blockCommentScalar, stringBodyScalar, countNewlinesScalar, "scalar"};
+}
+
+const ScanFunctions& scanFunctions() {
+    static const ScanFunctions functions = selectScanFunctions();
+    return functions;
+}
@@ -0,0 +1,28 @@
+#ifndef TC3002_COMPILER_SIMDSCAN_H
+#define TC3002_COMPILER_SIMDSCAN_H
+
+#include <cstddef>
+
+// Run scanners for the lexer's hot loops. Each one starts at data[from] and
+// returns the index of the first byte that ends the run, or `end` if the run
+// reaches the end of the buffer. The implementation (AVX2, SSE2 or scalar) is
+// picked once at startup from the CPU's features.
+struct ScanFunctions {
+    // First byte that isspace() rejects
+    size_t (*whitespace)(const char* data, size_t from, size_t end);
+    // First byte outside [A-Za-z0-9_]
+    size_t (*identifier)(const char* data, size_t from, size_t end);
+    // First '\n' or '\0'
+    size_t (*lineComment)(const char* data, size_t from, size_t end);
+    // Start of the first "*/"
+    size_t (*blockComment)(const char* data, size_t from, size_t end);
+    // First '"', '\\', '\n' or non-ASCII byte
+    size_t (*stringBody)(const char* data, size_t from, size_t end);
+    // Number of '\n' bytes in [from, end)
+    size_t (*countNewlines)(const char* data, size_t from, size_t end);
+    const char* name;
+};
+
+const ScanFunctions& scanFunctions();
+
+#endif //TC3002_COMPILER_SIMDSCAN_H
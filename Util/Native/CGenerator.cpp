@@ -0,0 +1,493 @@
+#include "CGenerator.h"
+#include "NativeRuntime.h"
+#include "../Lexer/Lexer.h"
+#include <stdexcept>
+
+using namespace std;
+
+// Precedes the runtime, which then declares everything static
+static const char* const RUNTIME_PREFIX = R"QUETZAL(/* Generated by the Quetzal compiler */
+#define QUETZAL_API static inline
+#define QUETZAL_DATA static
+)QUETZAL";
+
+static const char* const ARITHMETIC_HELPERS = R"QUETZAL(
+/* Arithmetic, wrapping at 32 bits like the VM */
+static inline int32_t quetzal_plus(int32_t a, int32_t b) { return (int32_t)((uint32_t)a + (uint32_t)b); }
+static inline int32_t quetzal_minus(int32_t a, int32_t b) { return (int32_t)((uint32_t)a - (uint32_t)b); }
+static inline int32_t quetzal_times(int32_t a, int32_t b) { return (int32_t)((uint32_t)a * (uint32_t)b); }
+static inline int32_t quetzal_negate(int32_t a) { return (int32_t)(0u - (uint32_t)a); }
+
+static inline int32_t quetzal_divide(int32_t a, int32_t b, int32_t line) {
+    if (b == 0) quetzal_division_by_zero(line);
+    return b == -1 ? quetzal_negate(a) : a / b;
+}
+
+static inline int32_t quetzal_remainder(int32_t a, int32_t b, int32_t line) {
+    if (b == 0) quetzal_division_by_zero(line);
+    return b == -1 ? 0 : a % b;
+}
+)QUETZAL";
+
+static bool isLiteral(NodeKind kind) {
+    return kind == NodeKind::IntLiteral || kind == NodeKind::CharLiteral || kind == NodeKind::BoolLiteral;
+}
+
+static const char* comparisonOperator(TokenKind op) {
+    switch (op) {
+        case TokenKind::EQUAL: return " == ";
+        case TokenKind::NOT_EQUAL: return " != ";
+        case TokenKind::LESS: return " < ";
+        case TokenKind::LESS_EQUAL: return " <= ";
+        case TokenKind::GREATER: return " > ";
+        case TokenKind::GREATER_EQUAL: return " >= ";
+        default: return nullptr;
+    }
+}
+
+static string integer(int32_t value) {
+    // -2147483648 would be the negation of a constant too large for int
+    return value == INT32_MIN ? "(-2147483647 - 1)" : to_string(value);
+}
+
+CGenerator::CGenerator(const Ast& ast, string_view source, const ProgramInfo& info)
+    : ast(ast), source(source), info(info) {
+    // Children are created before their parents, so one forward sweep
+    // propagates the flags up the tree
+    effects.assign(ast.size(), 0);
+    for (NodeId id = 0; id < ast.size(); id++) {
+        const Node& n = ast.node(id);
+        uint8_t flags = 0;
+        if (n.kind == NodeKind::Assign || n.kind == NodeKind::Call || n.kind == NodeKind::StringLiteral
+            || n.kind == NodeKind::ArrayLiteral) {
+            flags = WRITES | TRAPS;
+        } else if (n.kind == NodeKind::ApiCall) {
+            flags = n.op == TokenKind::GET || n.op == TokenKind::SIZE ? TRAPS : WRITES | TRAPS;
+            if (n.op == TokenKind::GET && (n.flags & IN_BOUNDS)) flags = 0;
+        } else if (n.kind == NodeKind::Binary && (n.op == TokenKind::SLASH || n.op == TokenKind::PERCENT)) {
+            flags = TRAPS;
+        }
+        for (uint32_t i = 0; i < n.count; i++) flags |= effects[ast.child(id, i)];
+        effects[id] = flags;
+    }
+}
+
+void CGenerator::generate(BufferedWriter& file) {
+    if (info.mainFunction == UNRESOLVED) {
+        throw runtime_error("Missing 'main' function");
+    }
+
+    BufferedWriter functions;
+    for (size_t i = 0; i < info.functions.size(); i++) {
+        function(i, functions);
+    }
+    entry(functions);
+
+    file << RUNTIME_PREFIX << nativeRuntimeSource() << ARITHMETIC_HELPERS << "\n/* Program */\n";
+    for (uint32_t global = 0; global < info.globals.size(); global++) {
+        file << "static int32_t g" << global << ";  /* " << ast.text(info.globals[global], source) << " */\n";
+    }
+    file << strings.take();
+    for (const auto& function : info.functions) {
+        file << "static int32_t " << functionName(ast.text(function.node, source)) << '(';
+        for (uint32_t i = 0; i < function.paramCount; i++) file << (i > 0 ? ", int32_t" : "int32_t");
+        file << (function.paramCount == 0 ? "void);\n" : ");\n");
+    }
+    file << '\n' << functions.take();
+}
+
+/* Helpers */
+string CGenerator::functionName(string_view name) {
+    // Prefixed like the assembly backend's symbols, so no name clashes with C
+    return "quetzal_fn_" + string(name);
+}
+
+string CGenerator::variable(uint32_t slot) const {
+    return slot & GLOBAL_SLOT ? "g" + to_string(slot & ~GLOBAL_SLOT) : "l" + to_string(slot);
+}
+
+string CGenerator::newTemp() {
+    return "t" + to_string(tempCount++);
+}
+
+void CGenerator::at(NodeId id) {
+    if (ast.node(id).ref != NO_REF) line = ast.refOf(id).line;
+}
+
+void CGenerator::writeLine(const string& text) {
+    for (uint32_t i = 0; i < indent; i++) *out << "    ";
+    *out << text << '\n';
+}
+
+/* Functions */
+void CGenerator::function(size_t index, BufferedWriter& file) {
+    const FunctionInfo& function = info.functions[index];
+    const Node& n = ast.node(function.node);
+    BufferedWriter body;
+    out = &body;
+    indent = 1;
+    tempCount = 0;
+    at(function.node);
+    NodeId block = ast.child(function.node, n.count - 1);
+    for (uint32_t i = 0; i < ast.node(block).count; i++) statement(ast.child(block, i));
+    writeLine("return 0;");  // Falling off the end returns 0
+
+    file << "static int32_t " << functionName(ast.text(function.node, source)) << '(';
+    for (uint32_t slot = 0; slot < function.paramCount; slot++) {
+        file << (slot > 0 ? ", int32_t l" : "int32_t l") << slot;
+    }
+    file << (function.paramCount == 0 ? "void) {\n" : ") {\n");
+    if (function.frameSize > function.paramCount) {
+        file << "    int32_t";
+        for (uint32_t slot = function.paramCount; slot < function.frameSize; slot++) {
+            file << (slot > function.paramCount ? ", l" : " l") << slot << " = 0";
+        }
+        file << ";\n";
+    }
+    if (tempCount > 0) {
+        file << "    int32_t";
+        for (uint32_t i = 0; i < tempCount; i++) file << (i > 0 ? ", t" : " t") << i;
+        file << ";\n";
+    }
+    file << body.take() << "}\n\n";
+}
+
+void CGenerator::entry(BufferedWriter& file) {
+    // Initialises the globals in declaration order, then runs main
+    BufferedWriter body;
+    out = &body;
+    indent = 1;
+    tempCount = 0;
+    writeLine("quetzal_start();");
+    for (uint32_t global = 0; global < info.globals.size(); global++) {
+        NodeId declarator = info.globals[global];
+        if (ast.node(declarator).count == 0) continue;  // Globals start at 0
+        at(declarator);
+        string value = expression(ast.child(declarator, 0));
+        writeLine("g" + to_string(global) + " = " + value + ";");
+    }
+    writeLine(functionName(ast.text(info.functions[info.mainFunction].node, source)) + "();");
+    writeLine("quetzal_finish();");
+    writeLine("return 0;");
+
+    file << "int main(void) {\n";
+    if (tempCount > 0) {
+        file << "    int32_t";
+        for (uint32_t i = 0; i < tempCount; i++) file << (i > 0 ? ", t" : " t") << i;
+        file << ";\n";
+    }
+    file << body.take() << "}\n";
+}
+
+/* Statements */
+void CGenerator::statement(NodeId id) {
+    const Node& n = ast.node(id);
+    at(id);
+    switch (n.kind) {
+        case NodeKind::Block:
+            writeLine("{");
+            body(id);
+            writeLine("}");
+            break;
+        case NodeKind::VarDecl:
+            for (uint32_t i = 0; i < n.count; i++) {
+                NodeId declarator = ast.child(id, i);
+                at(declarator);
+                // Declaration re-runs in loops reset the variable as well
+                string value = ast.node(declarator).count > 0 ? assignedValue(ast.child(declarator, 0)) : "0";
+                writeLine(variable(info.slots[declarator]) + " = " + value + ";");
+            }
+            break;
+        case NodeKind::If:
+            ifStatement(id);
+            break;
+        case NodeKind::Loop:
+            loopStatement(id);
+            break;
+        case NodeKind::Break:
+            writeLine("break;");
+            break;
+        case NodeKind::Return:
+            writeLine("return " + (n.count > 0 ? expression(ast.child(id, 0)) : string("0")) + ";");
+            break;
+        case NodeKind::Inc:
+        case NodeKind::Dec: {
+            string name = variable(info.slots[id]);
+            writeLine(name + (n.kind == NodeKind::Inc ? " = quetzal_plus(" : " = quetzal_minus(") + name + ", 1);");
+            break;
+        }
+        case NodeKind::ExprStmt:
+            effect(ast.child(id, 0));
+            break;
+        default:
+            break;
+    }
+}
+
+void CGenerator::body(NodeId id) {
+    indent++;
+    if (ast.node(id).kind == NodeKind::Block) {
+        for (uint32_t i = 0; i < ast.node(id).count; i++) statement(ast.child(id, i));
+    } else {
+        statement(id);
+    }
+    indent--;
+}
+
+void CGenerator::ifStatement(NodeId id) {
+    const Node& n = ast.node(id);
+    writeLine("if (" + expression(ast.child(id, 0)) + ") {");
+    body(ast.child(id, 1));
+    uint32_t nested = 0;  // elif conditions that needed statements of their own
+    uint32_t i = 2;
+    for (; i + 1 < n.count; i += 2) {
+        string prelude;
+        string test = condition(ast.child(id, i), prelude);
+        if (prelude.empty()) {
+            writeLine("} else if (" + test + ") {");
+        } else {
+            writeLine("} else {");
+            *out << prelude;
+            indent++;
+            nested++;
+            writeLine("if (" + test + ") {");
+        }
+        body(ast.child(id, i + 1));
+    }
+    if (i < n.count) {
+        writeLine("} else {");
+        body(ast.child(id, i));
+    }
+    writeLine("}");
+    for (; nested > 0; nested--) {
+        indent--;
+        writeLine("}");
+    }
+}
+
+void CGenerator::loopStatement(NodeId id) {
+    const Node& n = ast.node(id);
+    if (n.count == 2) {
+        // The condition is re-evaluated on every iteration, statements included
+        string prelude;
+        string test = condition(ast.child(id, 0), prelude);
+        if (prelude.empty()) {
+            writeLine("while (" + test + ") {");
+        } else {
+            writeLine("for (;;) {");
+            *out << prelude;
+            indent++;
+            writeLine("if (!" + test + ") break;");
+            indent--;
+        }
+    } else {
+        writeLine("for (;;) {");
+    }
+    body(ast.child(id, n.count - 1));
+    writeLine("}");
+}
+
+void CGenerator::effect(NodeId id) {
+    // An expression evaluated only for what it does
+    const Node& n = ast.node(id);
+    at(id);
+    switch (n.kind) {
+        case NodeKind::Assign: {
+            string value = assignedValue(ast.child(id, 0));
+            writeLine(variable(info.slots[id]) + " = " + value + ";");
+            break;
+        }
+        case NodeKind::Call:
+            writeLine(expression(id) + ";");
+            break;
+        case NodeKind::ApiCall:
+            writeLine(apiCall(id, false) + ";");
+            break;
+        default:
+            writeLine("(void)" + expression(id) + ";");
+            break;
+    }
+}
+
+/* Expressions */
+string CGenerator::expression(NodeId id) {
+    const Node& n = ast.node(id);
+    at(id);
+    switch (n.kind) {
+        case NodeKind::IntLiteral:
+        case NodeKind::CharLiteral:
+        case NodeKind::BoolLiteral:
+            return integer(n.value);
+        case NodeKind::StringLiteral:
+            return stringLiteral(id);
+        case NodeKind::ArrayLiteral:
+            return arrayLiteral(id);
+        case NodeKind::Identifier:
+            return variable(info.slots[id]);
+        case NodeKind::Assign:
+            return "(" + variable(info.slots[id]) + " = " + assignedValue(ast.child(id, 0)) + ")";
+        case NodeKind::Binary:
+            return binary(id);
+        case NodeKind::Unary: {
+            string operand = expression(ast.child(id, 0));
+            if (n.op == TokenKind::MINUS) return "quetzal_negate(" + operand + ")";
+            if (n.op == TokenKind::NOT) return "(!" + operand + ")";
+            return operand;
+        }
+        case NodeKind::Call: {
+            vector<string> arguments = operands(id);
+            string call = functionName(ast.text(info.functions[info.slots[id]].node, source)) + "(";
+            for (size_t i = 0; i < arguments.size(); i++) call += (i > 0 ? ", " : "") + arguments[i];
+            return call + ")";
+        }
+        case NodeKind::ApiCall:
+            return apiCall(id, true);
+        default:
+            return "0";
+    }
+}
+
+string CGenerator::assignedValue(NodeId id) {
+    // C leaves a store unsequenced with stores inside its value, so a value
+    // that writes is computed first
+    string value = expression(id);
+    if (!(effects[id] & WRITES) || ast.node(id).kind == NodeKind::ArrayLiteral) return value;
+    string temp = newTemp();
+    writeLine(temp + " = " + value + ";");
+    return temp;
+}
+
+string CGenerator::condition(NodeId id, string& prelude) {
+    BufferedWriter captured;
+    BufferedWriter* saved = out;
+    out = &captured;
+    indent++;
+    string test = expression(id);
+    indent--;
+    out = saved;
+    prelude = captured.take();
+    return test;
+}
+
+vector<string> CGenerator::operands(NodeId id) {
+    // An operand is evaluated into a temporary before a later one runs when
+    // the order could show: one writes what the other reads, or both trap
+    const Node& n = ast.node(id);
+    auto reads = [&](NodeId child) { return !isLiteral(ast.node(child).kind); };
+    auto conflict = [&](NodeId first, NodeId second) {
+        uint8_t a = effects[first], b = effects[second];
+        return ((b & WRITES) && reads(first)) || ((a & WRITES) && reads(second)) || ((a & TRAPS) && (b & TRAPS));
+    };
+    vector<string> values;
+    for (uint32_t i = 0; i < n.count; i++) {
+        NodeId child = ast.child(id, i);
+        string value = expression(child);
+        bool spill = false;
+        for (uint32_t j = i + 1; j < n.count && !spill; j++) spill = conflict(child, ast.child(id, j));
+        if (spill && reads(child)) {
+            string temp = newTemp();
+            writeLine(temp + " = " + value + ";");
+            value = temp;
+        }
+        values.push_back(std::move(value));
+    }
+    return values;
+}
+
+string CGenerator::binary(NodeId id) {
+    const Node& n = ast.node(id);
+    if (n.op == TokenKind::AND || n.op == TokenKind::OR) return logical(id);
+    uint32_t opLine = line;
+    vector<string> values = operands(id);
+    const string& left = values[0];
+    const string& right = values[1];
+    switch (n.op) {
+        case TokenKind::PLUS: return "quetzal_plus(" + left + ", " + right + ")";
+        case TokenKind::MINUS: return "quetzal_minus(" + left + ", " + right + ")";
+        case TokenKind::ASTERISK: return "quetzal_times(" + left + ", " + right + ")";
+        case TokenKind::SLASH: return "quetzal_divide(" + left + ", " + right + ", " + to_string(opLine) + ")";
+        case TokenKind::PERCENT: return "quetzal_remainder(" + left + ", " + right + ", " + to_string(opLine) + ")";
+        default: break;
+    }
+    const char* comparison = comparisonOperator(n.op);
+    if (!comparison) throw runtime_error("Unsupported binary operator");
+    return "(" + left + comparison + right + ")";
+}
+
+string CGenerator::logical(NodeId id) {
+    const Node& n = ast.node(id);
+    bool isAnd = n.op == TokenKind::AND;
+    string left = expression(ast.child(id, 0));
+    string prelude;
+    string right = condition(ast.child(id, 1), prelude);
+    if (prelude.empty()) {
+        return "(" + left + (isAnd ? " && " : " || ") + right + ")";
+    }
+    // The right operand needs statements, which may only run when it is reached
+    string result = newTemp();
+    writeLine(result + " = " + left + " != 0;");
+    writeLine(isAnd ? "if (" + result + ") {" : "if (!" + result + ") {");
+    *out << prelude;
+    indent++;
+    writeLine(result + " = " + right + " != 0;");
+    indent--;
+    writeLine("}");
+    return result;
+}
+
+string CGenerator::apiCall(NodeId id, bool asValue) {
+    const Node& n = ast.node(id);
+    if (n.count != static_cast<uint32_t>(apiArity(n.op))) {
+        throw runtime_error("Wrong number of arguments to '" + string(ast.text(id, source)) + "'");
+    }
+    string where = to_string(line);
+    vector<string> args = operands(id);
+    string call;
+    switch (n.op) {
+        case TokenKind::READI: return "quetzal_readi()";
+        case TokenKind::READS: return "quetzal_reads()";
+        case TokenKind::NEW: return "quetzal_new(" + args[0] + ", " + where + ")";
+        case TokenKind::SIZE: return "quetzal_size(" + args[0] + ", " + where + ")";
+        case TokenKind::GET:
+            if (n.flags & IN_BOUNDS) return "quetzal_get_unchecked(" + args[0] + ", " + args[1] + ")";
+            return "quetzal_get(" + args[0] + ", " + args[1] + ", " + where + ")";
+        case TokenKind::PRINTI: call = "quetzal_printi(" + args[0] + ")"; break;
+        case TokenKind::PRINTC: call = "quetzal_printc(" + args[0] + ")"; break;
+        case TokenKind::PRINTS: call = "quetzal_prints(" + args[0] + ", " + where + ")"; break;
+        case TokenKind::PRINTLN: call = "quetzal_println()"; break;
+        case TokenKind::ADD: call = "quetzal_add(" + args[0] + ", " + args[1] + ", " + where + ")"; break;
+        // Writes keep their check even IN_BOUNDS: without it, cc -O2 merges
+        // the two stores of a swap of neighbours into one 8-byte store, and
+        // the next iteration's overlapping load stalls waiting for it
+        case TokenKind::SET: call = "quetzal_set(" + args[0] + ", " + args[1] + ", " + args[2] + ", " + where + ")"; break;
+        default: throw runtime_error("Unsupported API function");
+    }
+    // The remaining API functions all return 0
+    return asValue ? "(" + call + ", 0)" : call;
+}
+
+string CGenerator::stringLiteral(NodeId id) {
+    // Each evaluation still creates a fresh array, from a constant shared by
+    // every equal literal
+    vector<int32_t> text = Lexer::decodeString(ast.text(id, source));
+    size_t size = text.size();
+    auto [entry, added] = stringNames.try_emplace(std::move(text), "s" + to_string(stringNames.size()));
+    const string& name = entry->second;
+    if (added) {
+        strings << "static const int32_t " << name << "[] = {";
+        for (size_t i = 0; i < size; i++) strings << (i > 0 ? ", " : "") << entry->first[i];
+        strings << (size == 0 ? "0};\n" : "};\n");
+    }
+    return "quetzal_string(" + name + ", " + to_string(size) + ")";
+}
+
+string CGenerator::arrayLiteral(NodeId id) {
+    const Node& n = ast.node(id);
+    string array = newTemp();
+    writeLine(array + " = quetzal_new(" + to_string(n.count) + ", " + to_string(line) + ");");
+    for (uint32_t i = 0; i < n.count; i++) {
+        string value = expression(ast.child(id, i));
+        writeLine("quetzal_set(" + array + ", " + to_string(i) + ", " + value + ", " + to_string(line) + ");");
+    }
+    return array;
+}
@@ -0,0 +1,75 @@
+#ifndef TC3002_COMPILER_CGENERATOR_H
+#define TC3002_COMPILER_CGENERATOR_H
+
+#include "../AST/AST.h"
+#include "../Output/BufferedWriter.h"
+#include "../Semantic/SemanticAnalyzer.h"
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Translates a checked syntax tree to portable C, leaving optimisation to
+// the host compiler. Locals become int32_t variables named by slot (l0,
+// l1...), globals file-scope ones (g0...), and array handles stay indices
+// into the runtime's table. The runtime from NativeRuntime.h is embedded as
+// static inline functions, so the output is one self-contained file.
+//
+// C leaves the order of operand and argument evaluation open, Quetzal
+// evaluates left to right: an operand whose order against a later one could
+// be observed is first copied to a temporary (t0, t1...). Arithmetic wraps
+// at 32 bits through unsigned helpers, since signed overflow is undefined.
+class CGenerator {
+private:
+    const Ast& ast;
+    std::string_view source;
+    const ProgramInfo& info;
+    // Per node, what evaluating its subtree may do: write (variables, arrays,
+    // output) and trap (runtime errors)
+    static constexpr uint8_t WRITES = 1;
+    static constexpr uint8_t TRAPS = 2;
+    std::vector<uint8_t> effects;
+
+    BufferedWriter* out = nullptr;  // Body of the function being translated
+    BufferedWriter strings;         // String constants, emitted before the functions
+    std::map<std::vector<int32_t>, std::string> stringNames;  // One constant per distinct literal
+    uint32_t indent = 0;
+    uint32_t line = 0;              // Passed to the runtime for error messages
+    uint32_t tempCount = 0;         // Temporaries of the current function
+
+    static std::string functionName(std::string_view name);
+    std::string variable(uint32_t slot) const;
+    std::string newTemp();
+    void at(NodeId id);
+    void writeLine(const std::string& text);
+
+    void function(size_t index, BufferedWriter& file);
+    void entry(BufferedWriter& file);
+
+    // Statements
+    void statement(NodeId id);
+    void body(NodeId id);  // A statement as the braced body of an if or loop
+    void ifStatement(NodeId id);
+    void loopStatement(NodeId id);
+    void effect(NodeId id);
+
+    // Expressions. Statements that must run first, to fix the evaluation
+    // order, are written out before the returned C expression is used.
+    std::string expression(NodeId id);
+    std::string assignedValue(NodeId id);
+    // Condition with its statements captured in `prelude` (at indent + 1)
+    std::string condition(NodeId id, std::string& prelude);
+    std::vector<std::string> operands(NodeId id);
+    std::string binary(NodeId id);
+    std::string logical(NodeId id);
+    std::string apiCall(NodeId id, bool asValue);
+    std::string stringLiteral(NodeId id);
+    std::string arrayLiteral(NodeId id);
+
+public:
+    CGenerator(const Ast& ast, std::string_view source, const ProgramInfo& info);
+    // Throws a runtime_error if the program has no main
+    void generate(BufferedWriter& out);
+};
+
+#endif //TC3002_COMPILER_CGENERATOR_H
@@ -0,0 +1,241 @@
+#include "NativeRuntime.h"
+
+static const char* const RUNTIME_SOURCE = R"QUETZAL(/* Quetzal native runtime */
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef QUETZAL_API
+#define QUETZAL_API
+#endif
+#ifndef QUETZAL_DATA
+#define QUETZAL_DATA
+#endif
+
+typedef struct {
+    int32_t* data;
+    int32_t size;
+    int32_t capacity;
+} QuetzalArray;
+
+/* Indexed by handle; generated code reads it directly */
+QUETZAL_DATA QuetzalArray* quetzal_arrays;
+QUETZAL_DATA uint32_t quetzal_array_count;
+static uint32_t quetzal_array_slots;
+
+/* Errors */
+static void quetzal_fail(int32_t line, const char* format, ...) __attribute__((noreturn, format(printf, 2, 3)));
+static void quetzal_fail(int32_t line, const char* format, ...) {
+    va_list args;
+    fflush(stdout);
+    fprintf(stderr, "[Line %d] Runtime Error: ", line);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+QUETZAL_API __attribute__((noreturn)) void quetzal_division_by_zero(int32_t line) {
+    quetzal_fail(line, "Division by zero");
+}
+
+/* Reports a failed get/set: a bad handle, or else a bad index */
+QUETZAL_API __attribute__((noreturn)) void quetzal_array_error(int32_t handle, int32_t index, int32_t line) {
+    if ((uint32_t)handle >= quetzal_array_count) quetzal_fail(line, "Invalid array handle %d", handle);
+    quetzal_fail(line, "Index %d out of bounds for array of size %d", index, quetzal_arrays[handle].size);
+}
+
+static QuetzalArray* quetzal_array(int32_t handle, int32_t line) {
+    if ((uint32_t)handle >= quetzal_array_count) quetzal_fail(line, "Invalid array handle %d", handle);
+    return &quetzal_arrays[handle];
+}
+
+/* Arrays */
+static int32_t quetzal_allocate(int32_t size, int32_t line) {
+    QuetzalArray* array;
+    int32_t capacity = size > 4 ? size : 4;
+    if (quetzal_array_count == quetzal_array_slots) {
+        uint32_t slots = quetzal_array_slots ? quetzal_array_slots * 2 : 64;
+        QuetzalArray* table = (QuetzalArray*)realloc(quetzal_arrays, slots * sizeof(QuetzalArray));
+        if (!table || slots > INT32_MAX) quetzal_fail(line, "Out of memory");
+        quetzal_arrays = table;
+        quetzal_array_slots = slots;
+    }
+    array = &quetzal_arrays[quetzal_array_count];
+    array->data = (int32_t*)calloc((size_t)capacity, sizeof(int32_t));
+    if (!array->data) quetzal_fail(line, "Out of memory");
+    array->size = size;
+    array->capacity = capacity;
+    return (int32_t)quetzal_array_count++;
+}
+
+QUETZAL_API int32_t quetzal_new(int32_t size, int32_t line) {
+    if (size < 0) quetzal_fail(line, "Negative array size %d", size);
+    return quetzal_allocate(size, line);
+}
+
+/* A fresh array holding a copy of the given elements, for literals */
+QUETZAL_API int32_t quetzal_string(const int32_t* values, int32_t count) {
+    int32_t handle = quetzal_allocate(count, 0);
+    int32_t* data = quetzal_arrays[handle].data;
+    int32_t i;
+    for (i = 0; i < count; i++) data[i] = values[i];
+    return handle;
+}
+
+QUETZAL_API int32_t quetzal_size(int32_t handle, int32_t line) {
+    return quetzal_array(handle, line)->size;
+}
+
+QUETZAL_API void quetzal_add(int32_t handle, int32_t value, int32_t line) {
+    QuetzalArray* array = quetzal_array(handle, line);
+    if (array->size == array->capacity) {
+        /* Geometric growth keeps add() amortised O(1) */
+        int32_t capacity = array->capacity <= INT32_MAX / 2 ? array->capacity * 2 : INT32_MAX;
+        int32_t* data = (int32_t*)realloc(array->data, (size_t)capacity * sizeof(int32_t));
+        if (!data || array->size == INT32_MAX) quetzal_fail(line, "Out of memory");
+        array->data = data;
+        array->capacity = capacity;
+    }
+    array->data[array->size++] = value;
+}
+
+QUETZAL_API int32_t quetzal_get(int32_t handle, int32_t index, int32_t line) {
+    QuetzalArray* array = quetzal_array(handle, line);
+    if ((uint32_t)index >= (uint32_t)array->size) quetzal_array_error(handle, index, line);
+    return array->data[index];
+}
+
+QUETZAL_API void quetzal_set(int32_t handle, int32_t index, int32_t value, int32_t line) {
+    QuetzalArray* array = quetzal_array(handle, line);
+    if ((uint32_t)index >= (uint32_t)array->size) quetzal_array_error(handle, index, line);
+    array->data[index] = value;
+}
+
+/* For reads the compiler proved valid */
+QUETZAL_API int32_t quetzal_get_unchecked(int32_t handle, int32_t index) {
+    return quetzal_arrays[handle].data[index];
+}
+
+/* Output */
+QUETZAL_API void quetzal_start(void) {
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+}
+
+QUETZAL_API void quetzal_finish(void) {
+    fflush(stdout);
+}
+
+QUETZAL_API void quetzal_printi(int32_t value) {
+    char digits[12];
+    char* p = digits + sizeof digits;
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    do {
+        *--p = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) *--p = '-';
+    fwrite(p, 1, (size_t)(digits + sizeof digits - p), stdout);
+}
+
+QUETZAL_API void quetzal_printc(int32_t codePoint) {
+    uint32_t c = (uint32_t)codePoint;
+    if (c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) c = 0xFFFD;
+    if (c < 0x80) {
+        putchar((int)c);
+    } else if (c < 0x800) {
+        putchar((int)(0xC0 | (c >> 6)));
+        putchar((int)(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+        putchar((int)(0xE0 | (c >> 12)));
+        putchar((int)(0x80 | ((c >> 6) & 0x3F)));
+        putchar((int)(0x80 | (c & 0x3F)));
+    } else {
+        putchar((int)(0xF0 | (c >> 18)));
+        putchar((int)(0x80 | ((c >> 12) & 0x3F)));
+        putchar((int)(0x80 | ((c >> 6) & 0x3F)));
+        putchar((int)(0x80 | (c & 0x3F)));
+    }
+}
+
+QUETZAL_API void quetzal_prints(int32_t handle, int32_t line) {
+    QuetzalArray* array = quetzal_array(handle, line);
+    int32_t i;
+    for (i = 0; i < array->size; i++) quetzal_printc(array->data[i]);
+}
+
+QUETZAL_API void quetzal_println(void) {
+    putchar('\n');
+}
+
+/* Input: one line at a time, without its line break */
+static char* quetzal_read_line(size_t* length) {
+    static char* line;
+    static size_t capacity;
+    size_t size = 0;
+    int c;
+    fflush(stdout);
+    while ((c = getchar()) != EOF && c != '\n') {
+        if (size + 1 >= capacity) {
+            capacity = capacity ? capacity * 2 : 128;
+            line = (char*)realloc(line, capacity);
+            if (!line) quetzal_fail(0, "Out of memory");
+        }
+        line[size++] = (char)c;
+    }
+    if (size > 0 && line[size - 1] == '\r') size--;
+    if (!line) {
+        capacity = 128;
+        line = (char*)malloc(capacity);
+        if (!line) quetzal_fail(0, "Out of memory");
+    }
+    line[size] = '\0';
+    *length = size;
+    return line;
+}
+
+/* Anything that is not a 32-bit integer reads as 0 */
+QUETZAL_API int32_t quetzal_readi(void) {
+    size_t length;
+    char* line = quetzal_read_line(&length);
+    char* start = line;
+    char* end = line + length;
+    char* parsed;
+    long value;
+    while (start < end && (*start == ' ' || *start == '\t')) start++;
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    if (start < end && *start == '+') start++;
+    if (start == end || !(*start == '-' || (*start >= '0' && *start <= '9'))) return 0;
+    *end = '\0';
+    errno = 0;
+    value = strtol(start, &parsed, 10);
+    if (parsed != end || errno || value < INT32_MIN || value > INT32_MAX) return 0;
+    return (int32_t)value;
+}
+
+/* The line's code points, decoded from UTF-8 */
+QUETZAL_API int32_t quetzal_reads(void) {
+    size_t length, i = 0;
+    const char* line = quetzal_read_line(&length);
+    int32_t handle = quetzal_allocate(0, 0);
+    while (i < length) {
+        unsigned char byte = (unsigned char)line[i];
+        size_t size = byte < 0x80 ? 1 : byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 1;
+        int32_t c;
+        size_t k;
+        if (i + size > length) size = 1;
+        c = size == 1 ? byte : byte & (0x3F >> (size - 1));
+        for (k = 1; k < size; k++) c = (c << 6) | (line[i + k] & 0x3F);
+        quetzal_add(handle, c, 0);
+        i += size;
+    }
+    return handle;
+}
+)QUETZAL";
+
+const char* nativeRuntimeSource() {
+    return RUNTIME_SOURCE;
+}
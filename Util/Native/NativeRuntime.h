@@ -0,0 +1,16 @@
+#ifndef TC3002_COMPILER_NATIVERUNTIME_H
+#define TC3002_COMPILER_NATIVERUNTIME_H
+
+// C source of the runtime that native Quetzal programs link against: the
+// array store and the I/O API, with the same semantics and error messages
+// as the VM. It is compiled next to the generated code, so the compiler
+// needs no installed support files.
+//
+// Arrays live in `quetzal_arrays`, a dense table of { data, size, capacity }
+// records indexed by handle, which generated code may read directly.
+// Functions are declared with QUETZAL_API (empty by default) and the table
+// with QUETZAL_DATA, so the source can also be included as a header of
+// static inline functions.
+const char* nativeRuntimeSource();
+
+#endif //TC3002_COMPILER_NATIVERUNTIME_H
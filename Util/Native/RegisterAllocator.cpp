@@ -0,0 +1,196 @@
+#include "RegisterAllocator.h"
+#include <algorithm>
+#include <bitset>
+
+using namespace std;
+
+using RegisterSet = bitset<MAX_REGISTERS>;
+
+/* Dataflow */
+static void registerEffects(const BytecodeProgram& program, const Instruction& instruction,
+                            RegisterSet& uses, RegisterSet& defs) {
+    uses.reset();
+    defs.reset();
+    switch (instruction.op) {
+        case Opcode::MOV: case Opcode::ADDI: case Opcode::NEG: case Opcode::NOT:
+        case Opcode::BOOL: case Opcode::NEW: case Opcode::SIZE:
+            defs.set(instruction.a);
+            uses.set(instruction.b);
+            break;
+        case Opcode::LOADI: case Opcode::GETG: case Opcode::READI: case Opcode::READS:
+        case Opcode::ARRAY: case Opcode::STRING:
+            defs.set(instruction.a);
+            break;
+        case Opcode::ADD: case Opcode::SUB: case Opcode::MUL: case Opcode::DIV: case Opcode::MOD:
+        case Opcode::EQ: case Opcode::NE: case Opcode::LT: case Opcode::LE: case Opcode::GT:
+        case Opcode::GE: case Opcode::GET: case Opcode::GETU:
+            defs.set(instruction.a);
+            uses.set(instruction.b);
+            uses.set(instruction.c);
+            break;
+        case Opcode::INC: case Opcode::DEC:
+            defs.set(instruction.a);
+            uses.set(instruction.a);
+            break;
+        case Opcode::SETG: case Opcode::JZ: case Opcode::JNZ: case Opcode::RET:
+        case Opcode::PRINTI: case Opcode::PRINTC: case Opcode::PRINTS:
+            uses.set(instruction.a);
+            break;
+        case Opcode::JEQ: case Opcode::JNE: case Opcode::JLT: case Opcode::JLE: case Opcode::JGT:
+        case Opcode::JGE: case Opcode::APPEND: case Opcode::SETK:
+            uses.set(instruction.a);
+            uses.set(instruction.b);
+            break;
+        case Opcode::SET: case Opcode::SETU:
+            uses.set(instruction.a);
+            uses.set(instruction.b);
+            uses.set(instruction.c);
+            break;
+        case Opcode::CALL:
+            for (uint32_t i = 0; i < program.functions[instruction.imm].paramCount; i++) {
+                uses.set(instruction.a + i);
+            }
+            defs.set(instruction.a);
+            break;
+        case Opcode::JMP: case Opcode::RET0: case Opcode::PRINTLN: case Opcode::HALT:
+        case Opcode::Count:
+            break;
+    }
+}
+
+bool RegisterAllocator::isCall(Opcode op) {
+    switch (op) {
+        case Opcode::CALL: case Opcode::PRINTI: case Opcode::PRINTC: case Opcode::PRINTS:
+        case Opcode::PRINTLN: case Opcode::READI: case Opcode::READS: case Opcode::NEW:
+        case Opcode::APPEND: case Opcode::ARRAY: case Opcode::SETK: case Opcode::STRING:
+        case Opcode::HALT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+Allocation RegisterAllocator::allocate(size_t function) const {
+    const BytecodeFunction& info = program.functions[function];
+    const uint32_t begin = info.entry;
+    const uint32_t count = program.functionEnd(function) - begin;
+    const uint32_t registers = info.registerCount;
+
+    vector<RegisterSet> uses(count), defs(count), liveIn(count), liveOut(count);
+    for (uint32_t i = 0; i < count; i++) {
+        registerEffects(program, program.code[begin + i], uses[i], defs[i]);
+    }
+
+    // Backward liveness per instruction, repeated until loops settle
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t i = count; i-- > 0;) {
+            const Instruction& instruction = program.code[begin + i];
+            RegisterSet out;
+            auto flowsTo = [&](uint32_t target) {
+                if (target >= begin && target - begin < count) out |= liveIn[target - begin];
+            };
+            switch (instruction.op) {
+                case Opcode::JMP:
+                    flowsTo(instruction.imm);
+                    break;
+                case Opcode::JZ: case Opcode::JNZ: case Opcode::JEQ: case Opcode::JNE:
+                case Opcode::JLT: case Opcode::JLE: case Opcode::JGT: case Opcode::JGE:
+                    flowsTo(instruction.imm);
+                    flowsTo(begin + i + 1);
+                    break;
+                case Opcode::RET: case Opcode::RET0: case Opcode::HALT:
+                    break;
+                default:
+                    flowsTo(begin + i + 1);
+                    break;
+            }
+            RegisterSet in = uses[i] | (out & ~defs[i]);
+            if (in != liveIn[i] || out != liveOut[i]) {
+                liveIn[i] = in;
+                liveOut[i] = out;
+                changed = true;
+            }
+        }
+    }
+
+    // Intervals over positions 2i (reads) and 2i + 1 (writes and values
+    // leaving instruction i), so an operand's register can be reused for the
+    // result of the instruction where it dies
+    vector<uint32_t> start(registers, UINT32_MAX), end(registers, 0);
+    vector<bool> crossesCall(registers, false);
+    auto extend = [&](uint32_t r, uint32_t position) {
+        start[r] = min(start[r], position);
+        end[r] = max(end[r], position);
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        bool call = isCall(program.code[begin + i].op);
+        for (uint32_t r = 0; r < registers; r++) {
+            if (liveIn[i][r] || uses[i][r]) extend(r, 2 * i);
+            if (defs[i][r]) extend(r, 2 * i + 1);
+            if (liveOut[i][r]) {
+                extend(r, 2 * i + 1);
+                if (call && !defs[i][r]) crossesCall[r] = true;
+            }
+        }
+    }
+
+    vector<uint32_t> order;
+    for (uint32_t r = 0; r < registers; r++) {
+        if (start[r] != UINT32_MAX) order.push_back(r);
+    }
+    stable_sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) { return start[x] < start[y]; });
+
+    Allocation allocation;
+    allocation.locations.resize(registers);
+    allocation.poolUsed.assign(callerSaved + calleeSaved, false);
+    allocation.liveOnEntry.assign(registers, false);
+    for (uint32_t r = 0; r < registers && count > 0; r++) allocation.liveOnEntry[r] = liveIn[0][r];
+    vector<bool> taken(callerSaved + calleeSaved, false);
+    vector<uint32_t> active;
+    auto spill = [&](uint32_t r) {
+        allocation.locations[r].reg = Location::NONE;
+        allocation.locations[r].slot = static_cast<int32_t>(allocation.spillSlots++);
+    };
+
+    for (uint32_t r : order) {
+        // Expire intervals that ended before this one starts
+        active.erase(remove_if(active.begin(), active.end(), [&](uint32_t other) {
+            if (end[other] >= start[r]) return false;
+            taken[allocation.locations[other].reg] = false;
+            return true;
+        }), active.end());
+
+        // Values that survive a call need a callee-saved register; the
+        // others try the caller-saved ones first
+        uint32_t first = crossesCall[r] ? callerSaved : 0;
+        uint32_t last = callerSaved + calleeSaved;
+        uint32_t chosen = last;
+        for (uint32_t p = first; p < last && chosen == last; p++) {
+            if (!taken[p]) chosen = p;
+        }
+
+        if (chosen == last) {
+            // Spill whichever interval ends last: this one, or an active one
+            // holding a register this one may use
+            auto victim = active.end();
+            for (auto it = active.begin(); it != active.end(); ++it) {
+                auto reg = static_cast<uint32_t>(allocation.locations[*it].reg);
+                if (reg >= first && (victim == active.end() || end[*it] > end[*victim])) victim = it;
+            }
+            if (victim == active.end() || end[*victim] <= end[r]) {
+                spill(r);
+                continue;
+            }
+            chosen = static_cast<uint32_t>(allocation.locations[*victim].reg);
+            spill(*victim);
+            active.erase(victim);
+        }
+
+        allocation.locations[r].reg = static_cast<int32_t>(chosen);
+        allocation.poolUsed[chosen] = true;
+        taken[chosen] = true;
+        active.push_back(r);
+    }
+    return allocation;
+}
@@ -0,0 +1,49 @@
+#ifndef TC3002_COMPILER_REGISTERALLOCATOR_H
+#define TC3002_COMPILER_REGISTERALLOCATOR_H
+
+#include "../Bytecode/Bytecode.h"
+#include <cstdint>
+#include <vector>
+
+// Where one bytecode register lives in native code
+struct Location {
+    static constexpr int32_t NONE = -1;
+
+    int32_t reg = NONE;   // Index into the machine register pool
+    int32_t slot = NONE;  // Spill slot, when not in a register
+};
+
+struct Allocation {
+    std::vector<Location> locations;  // Per bytecode register
+    uint32_t spillSlots = 0;
+    std::vector<bool> poolUsed;       // Per pool register
+    std::vector<bool> liveOnEntry;    // Per bytecode register: parameters whose value is read
+};
+
+// Linear-scan allocation (Poletto and Sarkar) of a function's bytecode
+// registers, locals and temporaries alike, to a pool of machine registers.
+// Live ranges come from a backward dataflow pass over the function's
+// instructions, flattened to one [first, last] interval per register, so values
+// carried around a loop stay allocated for the whole loop.
+//
+// The pool lists `callerSaved` registers first, then `calleeSaved` ones.
+// A value live across a call (to a Quetzal function or to the runtime)
+// only gets a callee-saved register, so calls never need to save anything.
+// When registers run out, the interval that ends last is spilled.
+class RegisterAllocator {
+private:
+    const BytecodeProgram& program;
+    uint32_t callerSaved;
+    uint32_t calleeSaved;
+
+public:
+    RegisterAllocator(const BytecodeProgram& program, uint32_t callerSaved, uint32_t calleeSaved)
+        : program(program), callerSaved(callerSaved), calleeSaved(calleeSaved) {}
+
+    Allocation allocate(size_t function) const;
+
+    // Instructions that call out, clobbering the caller-saved registers
+    static bool isCall(Opcode op);
+};
+
+#endif //TC3002_COMPILER_REGISTERALLOCATOR_H
@@ -0,0 +1,88 @@
+#include "Toolchain.h"
+#include "NativeRuntime.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+#ifndef _WIN32
+// Runs a program found on PATH and waits for it; returns its exit status
+static int runProgram(const vector<string>& arguments) {
+    vector<char*> argv;
+    for (const auto& argument : arguments) argv.push_back(const_cast<char*>(argument.c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    int error = posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ);
+    if (error != 0) throw runtime_error("Could not run " + arguments[0]);
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) throw runtime_error("Could not wait for " + arguments[0]);
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void writeText(const fs::path& path, const string& text) {
+    ofstream file(path, ios::binary);
+    file << text;
+    if (!file) throw runtime_error("Could not write " + path.string());
+}
+
+// Writes `files` to a private temporary directory and has the C compiler
+// build them into an executable
+static void buildExecutable(const vector<pair<string, string>>& files, const string& outputPath) {
+    string pattern = (fs::temp_directory_path() / "quetzal-XXXXXX").string();
+    if (!mkdtemp(pattern.data())) throw runtime_error("Could not create a temporary directory");
+    fs::path directory = pattern;
+
+    try {
+        const char* compiler = getenv("CC");
+        vector<string> command = {compiler && *compiler ? compiler : "cc", "-O2", "-o", outputPath};
+        for (const auto& [name, text] : files) {
+            fs::path path = directory / name;
+            writeText(path, text);
+            command.push_back(path.string());
+        }
+        int status = runProgram(command);
+        if (status != 0) {
+            throw runtime_error("Linking " + outputPath + " failed (status " + to_string(status) + ")");
+        }
+    } catch (...) {
+        error_code ignored;
+        fs::remove_all(directory, ignored);
+        throw;
+    }
+    error_code ignored;
+    fs::remove_all(directory, ignored);
+}
+
+void linkExecutable(const string& assembly, const string& outputPath) {
+    buildExecutable({{"program.s", assembly}, {"quetzal_runtime.c", nativeRuntimeSource()}}, outputPath);
+}
+
+void compileC(const string& source, const string& outputPath) {
+    buildExecutable({{"program.c", source}}, outputPath);
+}
+#else
+void linkExecutable(const string&, const string&) {
+    throw runtime_error("Native executables need a System V x86-64 toolchain");
+}
+
+void compileC(const string&, const string&) {
+    throw runtime_error("Native executables need a POSIX C toolchain");
+}
+#endif
@@ -0,0 +1,17 @@
+#ifndef TC3002_COMPILER_TOOLCHAIN_H
+#define TC3002_COMPILER_TOOLCHAIN_H
+
+#include <string>
+
+// Assembles `assembly` and links it with the native runtime into an
+// executable at `outputPath`. The system C compiler does both steps: $CC
+// when set, cc otherwise. Intermediate files go to a private temporary
+// directory that is removed afterwards. Throws a runtime_error if the
+// toolchain cannot be run or fails.
+void linkExecutable(const std::string& assembly, const std::string& outputPath);
+
+// Same for a self-contained C translation (see CGenerator), compiled with
+// -O2 into an executable at `outputPath`
+void compileC(const std::string& source, const std::string& outputPath);
+
+#endif //TC3002_COMPILER_TOOLCHAIN_H
@@ -0,0 +1,525 @@
+#include "X86Generator.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+/* Machine registers */
+enum : int { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+static const char* const NAMES_32[] = {
+    "%eax", "%ecx", "%edx", "%ebx", "%esp", "%ebp", "%esi", "%edi",
+    "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d"
+};
+static const char* const NAMES_64[] = {
+    "%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi",
+    "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15"
+};
+
+// Allocation pool, caller-saved first. %rax, %rdx, %r10 and %r11 stay free
+// as scratch: division needs %eax and %edx, array access %rax and %r10.
+static const int POOL[] = {RCX, RSI, RDI, R8, R9, RBX, R12, R13, R14, R15};
+constexpr uint32_t CALLER_SAVED = 5;
+constexpr uint32_t CALLEE_SAVED = 5;
+static const int ARGUMENT_REGISTERS[] = {RDI, RSI, RDX, RCX, R8, R9};
+constexpr uint32_t REGISTER_ARGUMENTS = 6;
+
+static const char* conditionSuffix(Opcode op) {
+    switch (op) {
+        case Opcode::EQ: case Opcode::JEQ: return "e";
+        case Opcode::NE: case Opcode::JNE: return "ne";
+        case Opcode::LT: case Opcode::JLT: return "l";
+        case Opcode::LE: case Opcode::JLE: return "le";
+        case Opcode::GT: case Opcode::JGT: return "g";
+        case Opcode::GE: case Opcode::JGE: return "ge";
+        default: throw runtime_error("Not a comparison");
+    }
+}
+
+static string pcLabel(uint32_t pc) {
+    return ".Lpc" + to_string(pc);
+}
+
+/* Helpers */
+string X86Generator::text(const Operand& operand) {
+    if (operand.immediate) return "$" + to_string(operand.value);
+    if (operand.inRegister()) return NAMES_32[operand.reg];
+    return to_string(operand.value) + "(%rbp)";
+}
+
+string X86Generator::text64(const Operand& operand) {
+    if (operand.immediate) return "$" + to_string(operand.value);
+    return NAMES_64[operand.reg];
+}
+
+string X86Generator::functionSymbol(const BytecodeProgram& program, size_t function) {
+    // Prefixed, so Quetzal names never clash with the runtime or libc
+    return function == program.entry ? "main" : "quetzal_fn_" + program.functions[function].name;
+}
+
+string X86Generator::newLabel() {
+    return ".Lerr" + to_string(labelCount++);
+}
+
+X86Generator::Operand X86Generator::at(uint32_t reg) const {
+    const Location& location = allocation.locations[reg];
+    if (location.reg != Location::NONE) return Operand::machine(POOL[location.reg]);
+    if (location.slot == Location::NONE) throw runtime_error("Register r" + to_string(reg) + " was not allocated");
+    return Operand::slot(-static_cast<int32_t>(8 * savedCount + 4 * (location.slot + 1)));
+}
+
+void X86Generator::instruction(const char* mnemonic, const string& first, const string& second) {
+    *out << "    " << mnemonic;
+    if (!first.empty()) *out << ' ' << first;
+    if (!second.empty()) *out << ", " << second;
+    *out << '\n';
+}
+
+void X86Generator::move(const Operand& dst, const Operand& src) {
+    if (dst == src) return;
+    if (dst.inRegister() && src.immediate && src.value == 0) {
+        instruction("xorl", text(dst), text(dst));
+    } else if (dst.inMemory() && src.inMemory()) {
+        instruction("movl", text(src), "%eax");
+        instruction("movl", "%eax", text(dst));
+    } else {
+        instruction("movl", text(src), text(dst));
+    }
+}
+
+void X86Generator::parallelMove(const vector<pair<Operand, Operand>>& moves) {
+    // In order, or in reverse, when no move overwrites a later move's source
+    auto safe = [&](bool reverse) {
+        for (size_t i = 0; i < moves.size(); i++) {
+            const Operand& dst = moves[reverse ? moves.size() - 1 - i : i].first;
+            if (!dst.inRegister()) continue;
+            for (size_t j = i + 1; j < moves.size(); j++) {
+                if (moves[reverse ? moves.size() - 1 - j : j].second.reg == dst.reg) return false;
+            }
+        }
+        return true;
+    };
+    if (safe(false)) {
+        for (const auto& [dst, src] : moves) move(dst, src);
+    } else if (safe(true)) {
+        for (auto it = moves.rbegin(); it != moves.rend(); ++it) move(it->first, it->second);
+    } else {
+        // Cycles go through the stack
+        for (const auto& [dst, src] : moves) {
+            if (src.inMemory()) {
+                instruction("movl", text(src), "%eax");
+                instruction("pushq", "%rax");
+            } else {
+                instruction("pushq", text64(src));
+            }
+        }
+        for (auto it = moves.rbegin(); it != moves.rend(); ++it) {
+            if (it->first.inRegister()) {
+                instruction("popq", NAMES_64[it->first.reg]);
+            } else {
+                instruction("popq", "%rax");
+                instruction("movl", "%eax", text(it->first));
+            }
+        }
+    }
+}
+
+void X86Generator::compare(const Operand& left, const Operand& right) {
+    // Flags as for left - right
+    if (left.inMemory() && right.inMemory()) {
+        instruction("movl", text(left), "%eax");
+        instruction("cmpl", text(right), "%eax");
+    } else {
+        instruction("cmpl", text(right), text(left));
+    }
+}
+
+void X86Generator::callRuntime(const char* name, const vector<Operand>& arguments) {
+    vector<pair<Operand, Operand>> moves;
+    for (size_t i = 0; i < arguments.size(); i++) {
+        moves.emplace_back(Operand::machine(ARGUMENT_REGISTERS[i]), arguments[i]);
+    }
+    parallelMove(moves);
+    instruction("call", name);
+}
+
+void X86Generator::arrayRecord(const Operand& handle, const string& fail) {
+    // Handles index a table of 16-byte { data, size, capacity } records.
+    // Without a failure label the handle is known to be valid.
+    move(Operand::machine(RAX), handle);
+    if (!fail.empty()) {
+        instruction("cmpl", "quetzal_array_count(%rip)", "%eax");
+        instruction("jae", fail);
+    }
+    instruction("shlq", "$4", "%rax");
+    instruction("addq", "quetzal_arrays(%rip)", "%rax");
+}
+
+string X86Generator::arrayErrorStub(const Operand& handle, const Operand& index) {
+    string label = newLabel();
+    BufferedWriter* body = out;
+    out = &stubs;
+    stubs << label << ":\n";
+    callRuntime("quetzal_array_error", {handle, index, Operand::constant(static_cast<int32_t>(line))});
+    out = body;
+    return label;
+}
+
+/* Program */
+void X86Generator::generate(BufferedWriter& target) {
+    out = &target;
+    *out << "# Quetzal program, x86-64 System V\n";
+    *out << "    .text\n";
+    for (size_t i = 0; i < program.functions.size(); i++) function(i);
+
+    if (program.globalCount > 0) {
+        *out << "    .bss\n    .p2align 2\nquetzal_globals:\n    .zero " << 4 * program.globalCount << '\n';
+    }
+    if (!program.strings.empty()) {
+        *out << "    .section .rodata\n    .p2align 2\n";
+        for (size_t i = 0; i < program.strings.size(); i++) {
+            *out << ".Lstr" << i << ":";
+            const char* separator = "\n    .long ";
+            for (int32_t c : program.strings[i]) {
+                *out << separator << c;
+                separator = ", ";
+            }
+            *out << '\n';
+        }
+    }
+    *out << "    .section .note.GNU-stack,\"\",@progbits\n";
+}
+
+void X86Generator::function(size_t index) {
+    const BytecodeFunction& function = program.functions[index];
+    const uint32_t end = program.functionEnd(index);
+    allocation = RegisterAllocator(program, CALLER_SAVED, CALLEE_SAVED).allocate(index);
+    savedRegisters.clear();
+    for (uint32_t p = CALLER_SAVED; p < CALLER_SAVED + CALLEE_SAVED; p++) {
+        if (allocation.poolUsed[p]) savedRegisters.push_back(POOL[p]);
+    }
+    savedCount = static_cast<uint32_t>(savedRegisters.size());
+    returnLabel = ".Lret" + to_string(index);
+
+    // Keeps %rsp 16-byte aligned at every call
+    uint32_t used = 8 * savedCount + 4 * allocation.spillSlots;
+    uint32_t frame = (used + 15) / 16 * 16 - 8 * savedCount;
+
+    string symbol = functionSymbol(program, index);
+    *out << "\n# " << function.name << "\n";
+    if (index == program.entry) *out << "    .globl main\n";
+    *out << "    .type " << symbol << ", @function\n    .p2align 4\n" << symbol << ":\n";
+    instruction("pushq", "%rbp");
+    instruction("movq", "%rsp", "%rbp");
+    for (int reg : savedRegisters) instruction("pushq", NAMES_64[reg]);
+    if (frame > 0) instruction("subq", "$" + to_string(frame), "%rsp");
+    if (index == program.entry) instruction("call", "quetzal_start");
+
+    // Parameters move from where the ABI put them to where they were
+    // allocated; one overwritten before it is read may share its register
+    vector<pair<Operand, Operand>> parameters;
+    for (uint32_t i = 0; i < function.paramCount; i++) {
+        if (!allocation.liveOnEntry[i]) continue;
+        Operand source = i < REGISTER_ARGUMENTS
+                         ? Operand::machine(ARGUMENT_REGISTERS[i])
+                         : Operand::slot(static_cast<int32_t>(16 + 8 * (i - REGISTER_ARGUMENTS)));
+        parameters.emplace_back(at(i), source);
+    }
+    parallelMove(parameters);
+
+    translate(function.entry, end);
+
+    *out << returnLabel << ":\n";
+    if (savedCount > 0) {
+        instruction("leaq", to_string(-8 * static_cast<int32_t>(savedCount)) + "(%rbp)", "%rsp");
+        for (auto it = savedRegisters.rbegin(); it != savedRegisters.rend(); ++it) {
+            instruction("popq", NAMES_64[*it]);
+        }
+        instruction("popq", "%rbp");
+    } else {
+        instruction("leave");
+    }
+    instruction("ret");
+    *out << stubs.take();
+}
+
+/* Instructions */
+void X86Generator::translate(uint32_t begin, uint32_t end) {
+    vector<bool> targets(end - begin, false);
+    for (uint32_t pc = begin; pc < end; pc++) {
+        switch (program.code[pc].op) {
+            case Opcode::JMP: case Opcode::JZ: case Opcode::JNZ: case Opcode::JEQ: case Opcode::JNE:
+            case Opcode::JLT: case Opcode::JLE: case Opcode::JGT: case Opcode::JGE:
+                targets[program.code[pc].imm - begin] = true;
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (uint32_t pc = begin; pc < end; pc++) {
+        const Instruction& in = program.code[pc];
+        line = program.lines[pc];
+        if (targets[pc - begin]) *out << pcLabel(pc) << ":\n";
+        const Operand lineNumber = Operand::constant(static_cast<int32_t>(line));
+
+        switch (in.op) {
+            case Opcode::MOV:
+                move(at(in.a), at(in.b));
+                break;
+            case Opcode::LOADI:
+                move(at(in.a), Operand::constant(in.imm));
+                break;
+            case Opcode::GETG:
+            case Opcode::SETG: {
+                string global = "quetzal_globals+" + to_string(4 * in.imm) + "(%rip)";
+                Operand value = at(in.a);
+                Operand reg = value.inRegister() ? value : Operand::machine(RAX);
+                if (in.op == Opcode::GETG) {
+                    instruction("movl", global, text(reg));
+                    move(value, reg);
+                } else {
+                    move(reg, value);
+                    instruction("movl", text(reg), global);
+                }
+                break;
+            }
+
+            case Opcode::ADD: case Opcode::SUB: case Opcode::MUL:
+                arithmetic(in);
+                break;
+            case Opcode::DIV: case Opcode::MOD:
+                division(in);
+                break;
+            case Opcode::ADDI: {
+                Operand dst = at(in.a), src = at(in.b);
+                if (dst == src) {
+                    instruction("addl", "$" + to_string(in.imm), text(dst));
+                } else if (dst.inRegister() && src.inRegister()) {
+                    instruction("leal", to_string(in.imm) + "(" + NAMES_64[src.reg] + ")", text(dst));
+                } else if (dst.inRegister()) {
+                    move(dst, src);
+                    instruction("addl", "$" + to_string(in.imm), text(dst));
+                } else {
+                    move(Operand::machine(RAX), src);
+                    instruction("addl", "$" + to_string(in.imm), "%eax");
+                    move(dst, Operand::machine(RAX));
+                }
+                break;
+            }
+            case Opcode::NEG: {
+                Operand dst = at(in.a), src = at(in.b);
+                Operand work = dst == src || dst.inRegister() ? dst : Operand::machine(RAX);
+                move(work, src);
+                instruction("negl", text(work));
+                move(dst, work);
+                break;
+            }
+            case Opcode::NOT:
+            case Opcode::BOOL: {
+                Operand dst = at(in.a);
+                instruction("cmpl", "$0", text(at(in.b)));
+                instruction(in.op == Opcode::NOT ? "sete" : "setne", "%al");
+                instruction("movzbl", "%al", dst.inRegister() ? text(dst) : "%eax");
+                if (!dst.inRegister()) move(dst, Operand::machine(RAX));
+                break;
+            }
+            case Opcode::EQ: case Opcode::NE: case Opcode::LT:
+            case Opcode::LE: case Opcode::GT: case Opcode::GE: {
+                Operand dst = at(in.a);
+                compare(at(in.b), at(in.c));
+                instruction((string("set") + conditionSuffix(in.op)).c_str(), "%al");
+                instruction("movzbl", "%al", dst.inRegister() ? text(dst) : "%eax");
+                if (!dst.inRegister()) move(dst, Operand::machine(RAX));
+                break;
+            }
+            case Opcode::INC:
+                instruction("addl", "$1", text(at(in.a)));
+                break;
+            case Opcode::DEC:
+                instruction("subl", "$1", text(at(in.a)));
+                break;
+
+            case Opcode::JMP:
+                instruction("jmp", pcLabel(in.imm));
+                break;
+            case Opcode::JZ:
+            case Opcode::JNZ: {
+                Operand value = at(in.a);
+                if (value.inRegister()) {
+                    instruction("testl", text(value), text(value));
+                } else {
+                    instruction("cmpl", "$0", text(value));
+                }
+                instruction(in.op == Opcode::JZ ? "je" : "jne", pcLabel(in.imm));
+                break;
+            }
+            case Opcode::JEQ: case Opcode::JNE: case Opcode::JLT:
+            case Opcode::JLE: case Opcode::JGT: case Opcode::JGE:
+                compare(at(in.a), at(in.b));
+                instruction((string("j") + conditionSuffix(in.op)).c_str(), pcLabel(in.imm));
+                break;
+
+            case Opcode::CALL:
+                call(in);
+                break;
+            case Opcode::RET:
+            case Opcode::RET0:
+                move(Operand::machine(RAX), in.op == Opcode::RET ? at(in.a) : Operand::constant(0));
+                if (pc + 1 < end) instruction("jmp", returnLabel);
+                break;
+            case Opcode::HALT:
+                instruction("call", "quetzal_finish");
+                move(Operand::machine(RAX), Operand::constant(0));
+                if (pc + 1 < end) instruction("jmp", returnLabel);
+                break;
+
+            case Opcode::PRINTI:
+                callRuntime("quetzal_printi", {at(in.a)});
+                break;
+            case Opcode::PRINTC:
+                callRuntime("quetzal_printc", {at(in.a)});
+                break;
+            case Opcode::PRINTS:
+                callRuntime("quetzal_prints", {at(in.a), lineNumber});
+                break;
+            case Opcode::PRINTLN:
+                callRuntime("quetzal_println", {});
+                break;
+            case Opcode::READI:
+            case Opcode::READS:
+                callRuntime(in.op == Opcode::READI ? "quetzal_readi" : "quetzal_reads", {});
+                move(at(in.a), Operand::machine(RAX));
+                break;
+            case Opcode::NEW:
+            case Opcode::ARRAY:
+                callRuntime("quetzal_new", {in.op == Opcode::NEW ? at(in.b) : Operand::constant(in.imm), lineNumber});
+                move(at(in.a), Operand::machine(RAX));
+                break;
+            case Opcode::APPEND:
+                callRuntime("quetzal_add", {at(in.a), at(in.b), lineNumber});
+                break;
+            case Opcode::SETK:
+                callRuntime("quetzal_set", {at(in.a), Operand::constant(in.imm), at(in.b), lineNumber});
+                break;
+            case Opcode::STRING:
+                instruction("leaq", ".Lstr" + to_string(in.imm) + "(%rip)", "%rdi");
+                instruction("movl", "$" + to_string(program.strings[in.imm].size()), "%esi");
+                instruction("call", "quetzal_string");
+                move(at(in.a), Operand::machine(RAX));
+                break;
+
+            case Opcode::SIZE: {
+                Operand dst = at(in.a);
+                arrayRecord(at(in.b), arrayErrorStub(at(in.b), Operand::constant(0)));
+                instruction("movl", "8(%rax)", dst.inRegister() ? text(dst) : "%eax");
+                if (!dst.inRegister()) move(dst, Operand::machine(RAX));
+                break;
+            }
+            case Opcode::GET:
+            case Opcode::SET:
+            case Opcode::GETU:
+            case Opcode::SETU: {
+                // get: a = b[c]; set: a[b] = c. GETU/SETU skip the checks.
+                bool isGet = in.op == Opcode::GET || in.op == Opcode::GETU;
+                bool checked = in.op == Opcode::GET || in.op == Opcode::SET;
+                Operand handle = at(isGet ? in.b : in.a);
+                Operand index = at(isGet ? in.c : in.b);
+                string fail = checked ? arrayErrorStub(handle, index) : "";
+                arrayRecord(handle, fail);
+                move(Operand::machine(R10), index);
+                if (checked) {
+                    instruction("cmpl", "8(%rax)", "%r10d");
+                    instruction("jae", fail);  // Unsigned, so negative indices fail too
+                }
+                instruction("movq", "(%rax)", "%rax");
+                if (isGet) {
+                    Operand dst = at(in.a);
+                    instruction("movl", "(%rax,%r10,4)", dst.inRegister() ? text(dst) : "%r10d");
+                    if (!dst.inRegister()) move(dst, Operand::machine(R10));
+                } else {
+                    Operand value = at(in.c);
+                    if (!value.inRegister()) {
+                        move(Operand::machine(RDX), value);
+                        value = Operand::machine(RDX);
+                    }
+                    instruction("movl", text(value), "(%rax,%r10,4)");
+                }
+                break;
+            }
+
+            case Opcode::Count:
+                throw runtime_error("Invalid opcode");
+        }
+    }
+}
+
+void X86Generator::call(const Instruction& in) {
+    const uint32_t count = program.functions[in.imm].paramCount;
+    const uint32_t stacked = count > REGISTER_ARGUMENTS ? count - REGISTER_ARGUMENTS : 0;
+    const uint32_t padding = stacked % 2 ? 8 : 0;
+
+    // Arguments past the sixth are pushed right to left
+    if (padding) instruction("subq", "$8", "%rsp");
+    for (uint32_t i = count; i-- > REGISTER_ARGUMENTS;) {
+        Operand argument = at(in.a + i);
+        if (argument.inMemory()) {
+            move(Operand::machine(RAX), argument);
+            argument = Operand::machine(RAX);
+        }
+        instruction("pushq", text64(argument));
+    }
+    vector<pair<Operand, Operand>> moves;
+    for (uint32_t i = 0; i < min(count, REGISTER_ARGUMENTS); i++) {
+        moves.emplace_back(Operand::machine(ARGUMENT_REGISTERS[i]), at(in.a + i));
+    }
+    parallelMove(moves);
+
+    instruction("call", functionSymbol(program, in.imm));
+    if (stacked + padding / 8 > 0) {
+        instruction("addq", "$" + to_string(8 * stacked + padding), "%rsp");
+    }
+    move(at(in.a), Operand::machine(RAX));
+}
+
+void X86Generator::arithmetic(const Instruction& in) {
+    const char* mnemonic = in.op == Opcode::ADD ? "addl" : in.op == Opcode::SUB ? "subl" : "imull";
+    bool commutative = in.op != Opcode::SUB;
+    Operand dst = at(in.a), left = at(in.b), right = at(in.c);
+    if (dst.inRegister() && dst != right) {
+        move(dst, left);
+        instruction(mnemonic, text(right), text(dst));
+    } else if (dst.inRegister() && commutative) {
+        instruction(mnemonic, text(left), text(dst));
+    } else {
+        move(Operand::machine(RAX), left);
+        instruction(mnemonic, text(right), "%eax");
+        move(dst, Operand::machine(RAX));
+    }
+}
+
+void X86Generator::division(const Instruction& in) {
+    // idiv traps on zero and on INT_MIN / -1, so both are tested first; a
+    // division by -1 is a wrapping negation and leaves no remainder
+    bool quotient = in.op == Opcode::DIV;
+    string fail = newLabel();
+    stubs << fail << ":\n    movl $" << line << ", %edi\n    call quetzal_division_by_zero\n";
+
+    move(Operand::machine(RAX), at(in.b));
+    move(Operand::machine(R10), at(in.c));
+    instruction("testl", "%r10d", "%r10d");
+    instruction("je", fail);
+    instruction("cmpl", "$-1", "%r10d");
+    instruction("jne", "1f");
+    if (quotient) {
+        instruction("negl", "%eax");
+    } else {
+        instruction("xorl", "%edx", "%edx");
+    }
+    instruction("jmp", "2f");
+    *out << "1:\n";
+    instruction("cltd");
+    instruction("idivl", "%r10d");
+    *out << "2:\n";
+    move(at(in.a), Operand::machine(quotient ? RAX : RDX));
+}
@@ -0,0 +1,77 @@
+#ifndef TC3002_COMPILER_X86GENERATOR_H
+#define TC3002_COMPILER_X86GENERATOR_H
+
+#include "RegisterAllocator.h"
+#include "../Bytecode/Bytecode.h"
+#include "../Output/BufferedWriter.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+// Translates bytecode to x86-64 assembly for the System V ABI, in GNU as
+// (AT&T) syntax, ready to be linked with the C runtime from NativeRuntime.h.
+// Bytecode registers are mapped to machine registers by RegisterAllocator,
+// so the instruction stream is translated one instruction at a time with no
+// further analysis. Quetzal functions pass their first six arguments in the
+// System V argument registers and the rest on the stack, and return in %eax.
+// get, set and size are inlined as a handle check, a bounds check and one
+// load or store; the other API calls go through the runtime.
+class X86Generator {
+private:
+    // A value an instruction reads or writes: a machine register, an
+    // immediate, or a 32-bit slot at an offset from %rbp
+    struct Operand {
+        int reg = -1;
+        bool immediate = false;
+        int32_t value = 0;  // Immediate value, or %rbp offset for a slot
+
+        static Operand machine(int reg) { return {reg, false, 0}; }
+        static Operand constant(int32_t value) { return {-1, true, value}; }
+        static Operand slot(int32_t offset) { return {-1, false, offset}; }
+        bool inRegister() const { return reg >= 0; }
+        bool inMemory() const { return reg < 0 && !immediate; }
+        bool operator==(const Operand& other) const {
+            return reg == other.reg && immediate == other.immediate && value == other.value;
+        }
+        bool operator!=(const Operand& other) const { return !(*this == other); }
+    };
+
+    const BytecodeProgram& program;
+    BufferedWriter* out = nullptr;  // Function body or its error stubs
+    BufferedWriter stubs;           // Out-of-line error paths of the current function
+
+    // State of the function being translated
+    Allocation allocation;
+    uint32_t savedCount = 0;
+    std::vector<int> savedRegisters;
+    std::string returnLabel;
+    uint32_t line = 0;
+    uint32_t labelCount = 0;
+
+    static std::string text(const Operand& operand);    // 32-bit form
+    static std::string text64(const Operand& operand);  // 64-bit form, registers and immediates only
+    static std::string functionSymbol(const BytecodeProgram& program, size_t function);
+    std::string newLabel();
+
+    Operand at(uint32_t reg) const;
+    void instruction(const char* mnemonic, const std::string& first = {}, const std::string& second = {});
+    void move(const Operand& dst, const Operand& src);
+    void parallelMove(const std::vector<std::pair<Operand, Operand>>& moves);
+    void compare(const Operand& left, const Operand& right);
+    void callRuntime(const char* name, const std::vector<Operand>& arguments);
+    // Points %rax at the array record of `handle`, or jumps to `fail`
+    void arrayRecord(const Operand& handle, const std::string& fail);
+    std::string arrayErrorStub(const Operand& handle, const Operand& index);
+
+    void function(size_t index);
+    void translate(uint32_t pc, uint32_t end);
+    void call(const Instruction& instruction);
+    void arithmetic(const Instruction& instruction);
+    void division(const Instruction& instruction);
+
+public:
+    explicit X86Generator(const BytecodeProgram& program) : program(program) {}
+    void generate(BufferedWriter& out);
+};
+
+#endif //TC3002_COMPILER_X86GENERATOR_H
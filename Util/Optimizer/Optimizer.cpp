@@ -0,0 +1,698 @@
+#include "Optimizer.h"
+#include "../Instrumentation/Instrumentation.h"
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+static inline int32_t wrap(uint32_t value) { return static_cast<int32_t>(value); }
+
+bool foldBinary(TokenKind op, int32_t left, int32_t right, int32_t& result) {
+    auto l = static_cast<uint32_t>(left), r = static_cast<uint32_t>(right);
+    switch (op) {
+        case TokenKind::PLUS: result = wrap(l + r); return true;
+        case TokenKind::MINUS: result = wrap(l - r); return true;
+        case TokenKind::ASTERISK: result = wrap(l * r); return true;
+        case TokenKind::SLASH:
+            if (right == 0) return false;
+            result = right == -1 ? wrap(0u - l) : left / right;
+            return true;
+        case TokenKind::PERCENT:
+            if (right == 0) return false;
+            result = right == -1 ? 0 : left % right;
+            return true;
+        case TokenKind::EQUAL: result = left == right; return true;
+        case TokenKind::NOT_EQUAL: result = left != right; return true;
+        case TokenKind::LESS: result = left < right; return true;
+        case TokenKind::LESS_EQUAL: result = left <= right; return true;
+        case TokenKind::GREATER: result = left > right; return true;
+        case TokenKind::GREATER_EQUAL: result = left >= right; return true;
+        default: return false;
+    }
+}
+
+static bool isComparison(TokenKind op) {
+    return op == TokenKind::EQUAL || op == TokenKind::NOT_EQUAL || op == TokenKind::LESS
+           || op == TokenKind::LESS_EQUAL || op == TokenKind::GREATER || op == TokenKind::GREATER_EQUAL;
+}
+
+void Optimizer::optimize() {
+    // Global initialisers run before main with no locals; only folding applies
+    state.locals.clear();
+    for (NodeId declarator : info.globals) {
+        state.reachable = true;
+        if (ast.node(declarator).count > 0) expression(ast.child(declarator, 0));
+    }
+
+    for (auto& current : info.functions) {
+        // Parameters are unknown, and locals are always declared before use.
+        // Room is left for the locals hoisting may add.
+        function = &current;
+        size_t slots = max(current.frameSize, HOISTING_FRAME_LIMIT);
+        state.locals.assign(slots, UNKNOWN);
+        state.nonNegative.assign(slots, 0);
+        state.sizeOf.assign(slots, NO_HANDLE);
+        state.reachable = true;
+        counting.assign(slots, 0);
+        const Node& n = ast.node(current.node);
+        block(ast.child(current.node, n.count - 1));
+    }
+    function = nullptr;
+}
+
+/* Helpers */
+bool Optimizer::literal(NodeId id, int32_t& value) const {
+    const Node& n = ast.node(id);
+    if (n.kind != NodeKind::IntLiteral && n.kind != NodeKind::CharLiteral && n.kind != NodeKind::BoolLiteral) {
+        return false;
+    }
+    value = n.value;
+    return true;
+}
+
+void Optimizer::makeLiteral(NodeId id, NodeKind kind, int32_t value) {
+    // The source reference stays, so the literal still has a location
+    QUETZAL_COUNT(ConstantsFolded);
+    Node& n = ast.node(id);
+    n.kind = kind;
+    n.op = TokenKind::UNKNOWN;
+    n.count = 0;
+    n.value = value;
+}
+
+void Optimizer::makeEmpty(NodeId id) {
+    QUETZAL_COUNT(DeadCodeRemoved);
+    Node& n = ast.node(id);
+    n.kind = NodeKind::Empty;
+    n.op = TokenKind::UNKNOWN;
+    n.count = 0;
+}
+
+void Optimizer::replace(NodeId id, NodeId with) {
+    // The copy shares the child list of the original, which is left unreferenced
+    ast.node(id) = ast.node(with);
+    info.slots[id] = info.slots[with];
+}
+
+void Optimizer::store(uint32_t slot, NodeId value) {
+    if (!isLocal(slot)) return;
+    forget(slot);
+    const Node& n = ast.node(value);
+    int32_t constant;
+    if (literal(value, constant)) {
+        state.locals[slot] = constant;
+        state.nonNegative[slot] = constant >= 0;
+    } else if (n.kind == NodeKind::ApiCall && n.op == TokenKind::SIZE) {
+        state.nonNegative[slot] = 1;
+        NodeId array = ast.child(value, 0);
+        uint32_t handle = info.slots[array];
+        if (ast.node(array).kind == NodeKind::Identifier && isLocal(handle) && handle != slot) {
+            state.sizeOf[slot] = handle;
+        }
+    } else if (n.kind == NodeKind::Identifier && isLocal(info.slots[value])) {
+        state.nonNegative[slot] = state.nonNegative[info.slots[value]];
+    }
+}
+
+void Optimizer::forget(uint32_t slot) {
+    if (!isLocal(slot)) return;
+    state.locals[slot] = UNKNOWN;
+    state.nonNegative[slot] = 0;
+    state.sizeOf[slot] = NO_HANDLE;
+    // A size read from this local no longer describes it
+    for (uint32_t& handle : state.sizeOf) {
+        if (handle == slot) handle = NO_HANDLE;
+    }
+}
+
+void Optimizer::merge(State& into, const State& other) {
+    // A path that cannot reach the join point contributes nothing
+    if (!other.reachable) return;
+    if (!into.reachable) {
+        into = other;
+        return;
+    }
+    for (size_t slot = 0; slot < into.locals.size(); slot++) {
+        if (into.locals[slot] != other.locals[slot]) into.locals[slot] = UNKNOWN;
+        into.nonNegative[slot] &= other.nonNegative[slot];
+        if (into.sizeOf[slot] != other.sizeOf[slot]) into.sizeOf[slot] = NO_HANDLE;
+    }
+}
+
+void Optimizer::assignedLocals(NodeId id, vector<uint8_t>& assigned) const {
+    vector<NodeId> stack = {id};
+    while (!stack.empty()) {
+        NodeId next = stack.back();
+        stack.pop_back();
+        const Node& n = ast.node(next);
+        switch (n.kind) {
+            case NodeKind::Assign:
+            case NodeKind::Declarator:
+            case NodeKind::Inc:
+            case NodeKind::Dec:
+                if (isLocal(info.slots[next])) assigned[info.slots[next]] = 1;
+                break;
+            default:
+                break;
+        }
+        for (uint32_t i = 0; i < n.count; i++) stack.push_back(ast.child(next, i));
+    }
+}
+
+/* Statements */
+void Optimizer::statement(NodeId id) {
+    // Only a statement directly in a block has somewhere to hoist to
+    vector<NodeId>* hoistInto = exchange(hoisted, nullptr);
+    const Node& n = ast.node(id);
+    switch (n.kind) {
+        case NodeKind::Block:
+            block(id);
+            break;
+        case NodeKind::VarDecl:
+            for (uint32_t i = 0; i < n.count; i++) {
+                NodeId declarator = ast.child(id, i);
+                uint32_t slot = info.slots[declarator];
+                if (ast.node(declarator).count > 0) {
+                    NodeId value = ast.child(declarator, 0);
+                    expression(value);
+                    store(slot, value);
+                } else if (isLocal(slot)) {
+                    forget(slot);
+                    state.locals[slot] = 0;  // A declaration without value resets to 0
+                    state.nonNegative[slot] = 1;
+                }
+            }
+            break;
+        case NodeKind::If:
+            ifStatement(id);
+            break;
+        case NodeKind::Loop:
+            loopStatement(id, hoistInto);
+            break;
+        case NodeKind::Break:
+            state.reachable = false;
+            break;
+        case NodeKind::Return:
+            if (n.count > 0) expression(ast.child(id, 0));
+            state.reachable = false;
+            break;
+        case NodeKind::Inc:
+        case NodeKind::Dec: {
+            uint32_t slot = info.slots[id];
+            if (!isLocal(slot)) break;
+            int64_t known = state.locals[slot];
+            // A counting variable is below its guard's bound, so 'inc' cannot wrap it
+            bool nonNegative = n.kind == NodeKind::Inc && counting[slot] && state.nonNegative[slot];
+            forget(slot);
+            if (known != UNKNOWN) {
+                auto value = static_cast<uint32_t>(known);
+                state.locals[slot] = wrap(n.kind == NodeKind::Inc ? value + 1 : value - 1);
+                nonNegative = state.locals[slot] >= 0;
+            }
+            state.nonNegative[slot] = nonNegative;
+            break;
+        }
+        case NodeKind::ExprStmt: {
+            expression(ast.child(id, 0));
+            int32_t value;
+            if (literal(ast.child(id, 0), value)) makeEmpty(id);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void Optimizer::block(NodeId id) {
+    // Statements are kept in place; the unreachable tail and empty statements
+    // go, and hoisted assignments come in before the loop they were taken from
+    uint32_t count = ast.node(id).count;
+    vector<NodeId> kept;
+    kept.reserve(count);
+    vector<NodeId> before;
+    bool changed = false;
+    for (uint32_t i = 0; i < count; i++) {
+        NodeId child = ast.child(id, i);
+        if (!state.reachable) {
+            QUETZAL_COUNT_BY(DeadCodeRemoved, count - i);
+            changed = true;
+            break;
+        }
+        before.clear();
+        hoisted = &before;
+        statement(child);
+        if (!before.empty()) {
+            kept.insert(kept.end(), before.begin(), before.end());
+            changed = true;
+        }
+        if (ast.node(child).kind != NodeKind::Empty) {
+            kept.push_back(child);
+        } else {
+            changed = true;
+        }
+    }
+    hoisted = nullptr;
+    if (changed) ast.replaceChildren(id, kept.data(), static_cast<uint32_t>(kept.size()));
+}
+
+void Optimizer::ifStatement(NodeId id) {
+    const Node& n = ast.node(id);
+    uint32_t count = n.count;
+    vector<NodeId> kept;
+    State exit;
+    exit.reachable = false;
+    bool taken = false;  // A condition folded to true: the arms after it are dead
+
+    uint32_t i = 0;
+    for (; i + 1 < count; i += 2) {
+        NodeId condition = ast.child(id, i);
+        NodeId body = ast.child(id, i + 1);
+        // Each condition runs after the ones before it failed
+        expression(condition);
+        int32_t value;
+        if (literal(condition, value)) {
+            if (value == 0) {
+                QUETZAL_COUNT(DeadCodeRemoved);
+                continue;
+            }
+            statement(body);
+            merge(exit, state);
+            kept.push_back(body);  // Becomes the else
+            taken = true;
+            break;
+        }
+        State skipped = state;
+        statement(body);
+        merge(exit, state);
+        state = std::move(skipped);
+        kept.push_back(condition);
+        kept.push_back(body);
+    }
+    if (!taken) {
+        if (i < count) {
+            NodeId otherwise = ast.child(id, i);
+            statement(otherwise);
+            kept.push_back(otherwise);
+        }
+        merge(exit, state);
+    } else if (i + 2 < count) {
+        QUETZAL_COUNT_BY(DeadCodeRemoved, (count - i - 1) / 2);
+    }
+    state = std::move(exit);
+
+    if (kept.empty()) {
+        makeEmpty(id);
+    } else if (kept.size() == 1) {
+        replace(id, kept[0]);  // Only an unconditional arm is left
+    } else if (kept.size() != count) {
+        ast.replaceChildren(id, kept.data(), static_cast<uint32_t>(kept.size()));
+    }
+}
+
+void Optimizer::loopStatement(NodeId id, vector<NodeId>* hoistInto) {
+    NodeId body = ast.child(id, ast.node(id).count - 1);
+    State before = state;
+    vector<uint8_t> assigned(state.locals.size(), 0);
+    assignedLocals(id, assigned);
+    for (uint32_t slot = 0; slot < assigned.size(); slot++) {
+        if (assigned[slot]) forget(slot);
+    }
+    // Counting variables stay non-negative on every iteration and after
+    vector<uint32_t> counters = countingVariables(id, before);
+    for (uint32_t slot : counters) state.nonNegative[slot] = 1;
+    State entry = state;
+
+    if (ast.node(id).count == 2) {
+        NodeId condition = ast.child(id, 0);
+        expression(condition);
+        int32_t value;
+        if (literal(condition, value)) {
+            if (value == 0) {
+                state = std::move(before);  // The body never runs
+                makeEmpty(id);
+                return;
+            }
+            QUETZAL_COUNT(ConstantsFolded);
+            ast.replaceChildren(id, &body, 1);  // loop (true) is a plain loop
+        }
+    }
+    vector<uint8_t> enclosing = counting;
+    for (uint32_t slot : counters) counting[slot] = 1;
+    statement(body);
+    counting = std::move(enclosing);
+
+    // Inner loops are done by now, and may have hoisted into this one
+    eliminateBoundsChecks(id, entry);
+    if (hoistInto != nullptr) {
+        fill(assigned.begin(), assigned.end(), 0);
+        assignedLocals(id, assigned);
+        uint32_t count = ast.node(id).count;
+        for (uint32_t i = 0; i < count; i++) hoist(ast.child(id, i), assigned, *hoistInto);
+    }
+
+    // Left through the condition or a break, after any number of iterations
+    state = std::move(entry);
+    state.reachable = true;
+}
+
+/* Expressions */
+void Optimizer::expression(NodeId id) {
+    const Node& n = ast.node(id);
+    switch (n.kind) {
+        case NodeKind::Identifier: {
+            uint32_t slot = info.slots[id];
+            if (isLocal(slot) && state.locals[slot] != UNKNOWN) {
+                makeLiteral(id, NodeKind::IntLiteral, static_cast<int32_t>(state.locals[slot]));
+            }
+            break;
+        }
+        case NodeKind::Assign:
+            expression(ast.child(id, 0));
+            store(info.slots[id], ast.child(id, 0));
+            break;
+        case NodeKind::Binary:
+            binary(id);
+            break;
+        case NodeKind::Unary: {
+            NodeId operand = ast.child(id, 0);
+            expression(operand);
+            int32_t value;
+            if (!literal(operand, value)) break;
+            if (n.op == TokenKind::MINUS) {
+                makeLiteral(id, NodeKind::IntLiteral, wrap(0u - static_cast<uint32_t>(value)));
+            } else if (n.op == TokenKind::NOT) {
+                makeLiteral(id, NodeKind::BoolLiteral, value == 0);
+            } else {
+                makeLiteral(id, ast.node(operand).kind, value);
+            }
+            break;
+        }
+        case NodeKind::Call:
+        case NodeKind::ApiCall:
+        case NodeKind::ArrayLiteral:
+            for (uint32_t i = 0; i < n.count; i++) expression(ast.child(id, i));
+            break;
+        default:
+            break;
+    }
+}
+
+void Optimizer::binary(NodeId id) {
+    TokenKind op = ast.node(id).op;
+    if (op == TokenKind::AND || op == TokenKind::OR) {
+        logical(id);
+        return;
+    }
+    NodeId left = ast.child(id, 0);
+    NodeId right = ast.child(id, 1);
+    expression(left);
+    expression(right);
+    int32_t l, r, result;
+    if (literal(left, l) && literal(right, r) && foldBinary(op, l, r, result)) {
+        makeLiteral(id, isComparison(op) ? NodeKind::BoolLiteral : NodeKind::IntLiteral, result);
+    }
+}
+
+void Optimizer::logical(NodeId id) {
+    bool isAnd = ast.node(id).op == TokenKind::AND;
+    NodeId left = ast.child(id, 0);
+    NodeId right = ast.child(id, 1);
+    expression(left);
+    int32_t l, r;
+    if (literal(left, l)) {
+        // 'false and x' and 'true or x' never evaluate x
+        if ((l != 0) != isAnd) {
+            makeLiteral(id, NodeKind::BoolLiteral, l != 0);
+            return;
+        }
+        expression(right);
+        if (literal(right, r)) makeLiteral(id, NodeKind::BoolLiteral, r != 0);
+        return;
+    }
+    // The right operand may not run
+    State skipped = state;
+    expression(right);
+    merge(state, skipped);
+}
+
+/* Loops */
+bool Optimizer::isBreak(NodeId id) const {
+    const Node& n = ast.node(id);
+    if (n.kind == NodeKind::Block && n.count == 1) return isBreak(ast.child(id, 0));
+    return n.kind == NodeKind::Break;
+}
+
+vector<NodeId> Optimizer::topLevel(NodeId body) const {
+    const Node& n = ast.node(body);
+    if (n.kind != NodeKind::Block) return {body};
+    return vector<NodeId>(ast.children(body), ast.children(body) + n.count);
+}
+
+void Optimizer::guardFacts(NodeId condition, bool truth, vector<Fact>& facts) const {
+    const Node& n = ast.node(condition);
+    if (n.kind == NodeKind::Unary && n.op == TokenKind::NOT) {
+        guardFacts(ast.child(condition, 0), !truth, facts);
+        return;
+    }
+    if (n.kind != NodeKind::Binary) return;
+    NodeId left = ast.child(condition, 0);
+    NodeId right = ast.child(condition, 1);
+    if (n.op == TokenKind::AND || n.op == TokenKind::OR) {
+        // Both operands are known only from a true 'and' or a false 'or'
+        if (truth == (n.op == TokenKind::AND)) {
+            guardFacts(left, truth, facts);
+            guardFacts(right, truth, facts);
+        }
+        return;
+    }
+    NodeId variable, bound;
+    if ((n.op == TokenKind::LESS && truth) || (n.op == TokenKind::GREATER_EQUAL && !truth)) {
+        variable = left;
+        bound = right;
+    } else if ((n.op == TokenKind::GREATER && truth) || (n.op == TokenKind::LESS_EQUAL && !truth)) {
+        variable = right;
+        bound = left;
+    } else {
+        return;
+    }
+    if (ast.node(variable).kind == NodeKind::Identifier && isLocal(info.slots[variable])) {
+        facts.push_back({info.slots[variable], bound});
+    }
+}
+
+vector<uint32_t> Optimizer::countingVariables(NodeId loop, const State& before) const {
+    // Every change of a counting variable must be a top-level 'inc' of the
+    // body, each with a guard on the variable since the previous one
+    size_t slots = state.locals.size();
+    vector<uint32_t> changes(slots, 0), increments(slots, 0);
+    vector<NodeId> stack = {loop};
+    while (!stack.empty()) {
+        NodeId next = stack.back();
+        stack.pop_back();
+        const Node& n = ast.node(next);
+        if ((n.kind == NodeKind::Assign || n.kind == NodeKind::Declarator || n.kind == NodeKind::Inc
+             || n.kind == NodeKind::Dec) && isLocal(info.slots[next])) {
+            changes[info.slots[next]]++;
+        }
+        for (uint32_t i = 0; i < n.count; i++) stack.push_back(ast.child(next, i));
+    }
+
+    vector<NodeId> statements = topLevel(ast.child(loop, ast.node(loop).count - 1));
+    for (NodeId statement : statements) {
+        const Node& n = ast.node(statement);
+        if (n.kind == NodeKind::Inc && isLocal(info.slots[statement])) increments[info.slots[statement]]++;
+    }
+
+    vector<uint8_t> guarded(slots, 0), rejected(slots, 0);
+    vector<Fact> facts;
+    if (ast.node(loop).count == 2) guardFacts(ast.child(loop, 0), true, facts);
+    for (NodeId statement : statements) {
+        for (const Fact& fact : facts) guarded[fact.variable] = 1;
+        facts.clear();
+        const Node& n = ast.node(statement);
+        if (n.kind == NodeKind::Inc && isLocal(info.slots[statement])) {
+            uint32_t slot = info.slots[statement];
+            if (!guarded[slot]) rejected[slot] = 1;
+            guarded[slot] = 0;
+        } else if (n.kind == NodeKind::If && n.count == 2 && isBreak(ast.child(statement, 1))) {
+            guardFacts(ast.child(statement, 0), false, facts);
+        }
+    }
+
+    vector<uint32_t> counters;
+    for (uint32_t slot = 0; slot < slots; slot++) {
+        if (increments[slot] == 0 || increments[slot] != changes[slot] || rejected[slot]) continue;
+        bool startsNonNegative = before.nonNegative[slot]
+                                 || (before.locals[slot] != UNKNOWN && before.locals[slot] >= 0);
+        if (startsNonNegative) counters.push_back(slot);
+    }
+    return counters;
+}
+
+bool Optimizer::bound(NodeId id, const State& entry, Bound& result) const {
+    // Interval arithmetic over 64 bits; a result that might wrap is unbounded
+    result = {INT32_MIN, INT32_MAX};
+    const Node& n = ast.node(id);
+    switch (n.kind) {
+        case NodeKind::IntLiteral:
+        case NodeKind::CharLiteral:
+            result = {n.value, n.value};
+            return true;
+        case NodeKind::Identifier: {
+            uint32_t slot = info.slots[id];
+            if (!isLocal(slot)) return false;
+            if (entry.sizeOf[slot] != NO_HANDLE) {
+                result = {0, INT32_MAX, entry.sizeOf[slot], 0};
+            } else if (entry.nonNegative[slot]) {
+                result = {0, INT32_MAX};
+            }
+            return true;
+        }
+        case NodeKind::ApiCall: {
+            if (n.op != TokenKind::SIZE) return false;
+            NodeId array = ast.child(id, 0);
+            uint32_t handle = info.slots[array];
+            if (ast.node(array).kind != NodeKind::Identifier || !isLocal(handle)) return false;
+            result = {0, INT32_MAX, handle, 0};
+            return true;
+        }
+        case NodeKind::Binary: {
+            if (n.op != TokenKind::PLUS && n.op != TokenKind::MINUS) return false;
+            Bound l, r;
+            bound(ast.child(id, 0), entry, l);
+            bound(ast.child(id, 1), entry, r);
+            bool minus = n.op == TokenKind::MINUS;
+            int64_t low = minus ? l.low - r.high : l.low + r.low;
+            int64_t high = minus ? l.high - r.low : l.high + r.high;
+            if (low < INT32_MIN || high > INT32_MAX) return false;
+            result = {low, high};
+            // Taking away a non-negative amount keeps an expression below a size
+            if (minus && l.handle != NO_HANDLE && r.low >= 0) {
+                result.handle = l.handle;
+                result.margin = l.margin + r.low;
+            } else if (!minus && l.handle != NO_HANDLE && r.high <= 0) {
+                result.handle = l.handle;
+                result.margin = l.margin - r.high;
+            } else if (!minus && r.handle != NO_HANDLE && l.high <= 0) {
+                result.handle = r.handle;
+                result.margin = r.margin - l.high;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+void Optimizer::markAccesses(NodeId id, const vector<Fact>& facts, const State& entry) {
+    vector<NodeId> stack = {id};
+    while (!stack.empty()) {
+        NodeId next = stack.back();
+        stack.pop_back();
+        const Node& n = ast.node(next);
+        for (uint32_t i = 0; i < n.count; i++) stack.push_back(ast.child(next, i));
+        if (n.kind != NodeKind::ApiCall || (n.op != TokenKind::GET && n.op != TokenKind::SET)
+            || (n.flags & IN_BOUNDS)) {
+            continue;
+        }
+
+        // get(a, i + c) with 0 <= i, c and i < e <= size(a) - c
+        NodeId array = ast.child(next, 0);
+        NodeId index = ast.child(next, 1);
+        if (ast.node(array).kind != NodeKind::Identifier || !isLocal(info.slots[array])) continue;
+        int32_t offset = 0;
+        const Node& in = ast.node(index);
+        if (in.kind == NodeKind::Binary && in.op == TokenKind::PLUS) {
+            NodeId left = ast.child(index, 0);
+            NodeId right = ast.child(index, 1);
+            if (!literal(right, offset)) {
+                swap(left, right);
+                if (!literal(right, offset)) continue;
+            }
+            index = left;
+        }
+        uint32_t variable = info.slots[index];
+        if (offset < 0 || ast.node(index).kind != NodeKind::Identifier || !isLocal(variable)
+            || !entry.nonNegative[variable]) {
+            continue;
+        }
+        for (const Fact& fact : facts) {
+            Bound limit;
+            if (fact.variable != variable || !bound(fact.bound, entry, limit)) continue;
+            if (limit.handle == info.slots[array] && limit.margin >= offset) {
+                ast.node(next).flags |= IN_BOUNDS;
+                QUETZAL_COUNT(BoundsChecksRemoved);
+                break;
+            }
+        }
+    }
+}
+
+void Optimizer::eliminateBoundsChecks(NodeId loop, const State& entry) {
+    // A guard's facts hold from it through the top-level statements that
+    // change neither the variable nor the array the bound refers to
+    vector<Fact> facts;
+    if (ast.node(loop).count == 2) guardFacts(ast.child(loop, 0), true, facts);
+    vector<uint8_t> changed(state.locals.size());
+    for (NodeId statement : topLevel(ast.child(loop, ast.node(loop).count - 1))) {
+        fill(changed.begin(), changed.end(), 0);
+        assignedLocals(statement, changed);
+        facts.erase(remove_if(facts.begin(), facts.end(), [&](const Fact& fact) {
+            Bound limit;
+            bool bounded = bound(fact.bound, entry, limit) && limit.handle != NO_HANDLE;
+            return !bounded || changed[fact.variable] || changed[limit.handle];
+        }), facts.end());
+        if (!facts.empty()) markAccesses(statement, facts, entry);
+
+        const Node& n = ast.node(statement);
+        if (n.kind == NodeKind::If && n.count == 2 && isBreak(ast.child(statement, 1))) {
+            guardFacts(ast.child(statement, 0), false, facts);
+        }
+    }
+}
+
+bool Optimizer::invariant(NodeId id, const vector<uint8_t>& assigned) const {
+    // Pure and unable to trap, so it may run once before the loop instead
+    const Node& n = ast.node(id);
+    switch (n.kind) {
+        case NodeKind::IntLiteral:
+        case NodeKind::CharLiteral:
+        case NodeKind::BoolLiteral:
+            return true;
+        case NodeKind::Identifier:
+            return isLocal(info.slots[id]) && !assigned[info.slots[id]];
+        case NodeKind::Unary:
+            return invariant(ast.child(id, 0), assigned);
+        case NodeKind::Binary:
+            return n.op != TokenKind::SLASH && n.op != TokenKind::PERCENT
+                   && invariant(ast.child(id, 0), assigned) && invariant(ast.child(id, 1), assigned);
+        default:
+            return false;
+    }
+}
+
+void Optimizer::hoist(NodeId id, const vector<uint8_t>& assigned, vector<NodeId>& statements) {
+    Node n = ast.node(id);
+    if ((n.kind == NodeKind::Binary || n.kind == NodeKind::Unary) && invariant(id, assigned)) {
+        if (function->frameSize >= HOISTING_FRAME_LIMIT) return;
+        // The expression moves to `local = expression;` and a read of the
+        // local takes its place. New expression nodes only refer to older
+        // ones, as the code generators' forward sweeps over the tree expect.
+        uint32_t slot = function->frameSize++;
+        vector<NodeId> children(ast.children(id), ast.children(id) + n.count);
+        NodeId value = ast.addNode(n.kind, n.ref, children.data(), n.count, n.value, n.op);
+        NodeId assign = ast.addNode(NodeKind::Assign, n.ref, &value, 1);
+        statements.push_back(ast.addNode(NodeKind::ExprStmt, NO_REF, &assign, 1));
+        info.slots.resize(ast.size(), UNRESOLVED);
+        info.slots[assign] = slot;
+        info.slots[id] = slot;
+        Node& read = ast.node(id);
+        read.kind = NodeKind::Identifier;
+        read.op = TokenKind::UNKNOWN;
+        read.count = 0;
+        read.value = 0;
+        QUETZAL_COUNT(InvariantsHoisted);
+        return;
+    }
+    for (uint32_t i = 0; i < n.count; i++) hoist(ast.child(id, i), assigned, statements);
+}
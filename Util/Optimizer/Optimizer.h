@@ -0,0 +1,112 @@
+#ifndef TC3002_COMPILER_OPTIMIZER_H
+#define TC3002_COMPILER_OPTIMIZER_H
+
+#include "../AST/AST.h"
+#include "../Semantic/SemanticAnalyzer.h"
+#include <cstdint>
+#include <vector>
+
+// Evaluates a binary operator on constants with Quetzal's semantics: 32-bit
+// wrapping arithmetic, truncating division, comparisons giving 0 or 1.
+// Returns false for a division by zero, which must stay a runtime error.
+bool foldBinary(TokenKind op, int32_t left, int32_t right, int32_t& result);
+
+// Simplifies a checked tree in place, before code generation:
+//
+// - Constant folding: operators whose operands are literals become literals,
+//   'and'/'or' included when the left operand decides the result.
+// - Constant propagation: a forward pass over each function tracks which
+//   locals hold a known value, and reads of them become literals. Branches
+//   merge their knowledge; a loop forgets every local it assigns.
+// - Dead code: if arms whose condition is a false literal are dropped, a true
+//   one becomes the else, loops whose condition is false disappear, and so
+//   do statements after a break or return.
+// - Loops: a counting variable (only ever 'inc'-ed, once after each guard
+//   'if (i >= e) break;' or under 'loop (i < e)', from a non-negative start)
+//   stays non-negative. Where a guard bounds it by size(a), directly or
+//   through n = size(a), get(a, i + c) and set(a, i + c, x) are flagged
+//   IN_BOUNDS, as arrays never shrink. Pure expressions over locals the loop
+//   does not assign, like n - 1, are then hoisted into a new local set just
+//   before the loop.
+//
+// Node ids are kept, so the ProgramInfo of the semantic analysis stays valid;
+// removed nodes are simply no longer referenced. Hoisting appends nodes and
+// locals and updates the ProgramInfo to match. Globals are never propagated,
+// since any call may change them.
+class Optimizer {
+private:
+    static constexpr int64_t UNKNOWN = INT64_MIN;
+    static constexpr uint32_t NO_HANDLE = UINT32_MAX;
+    // Hoisting adds locals; functions with frames this large get no more
+    static constexpr uint32_t HOISTING_FRAME_LIMIT = 128;
+
+    // What is known at a point of the function being optimised
+    struct State {
+        std::vector<int64_t> locals;       // Value per local slot, UNKNOWN when not constant
+        std::vector<uint8_t> nonNegative;  // Per local slot: known to be >= 0
+        std::vector<uint32_t> sizeOf;      // Per local slot: the local whose size(a) it holds
+        bool reachable = true;
+    };
+
+    // `variable` < `bound` wherever a loop guard makes the fact hold
+    struct Fact {
+        uint32_t variable;
+        NodeId bound;
+    };
+
+    // Range of a bound expression and, when it is at most
+    // size(handle) - margin, that handle
+    struct Bound {
+        int64_t low;
+        int64_t high;
+        uint32_t handle = NO_HANDLE;
+        int64_t margin = 0;
+    };
+
+    Ast& ast;
+    ProgramInfo& info;
+    State state;
+    FunctionInfo* function = nullptr;
+    std::vector<uint8_t> counting;          // Per local slot: counting variable of an enclosing loop
+    std::vector<NodeId>* hoisted = nullptr;  // Where a statement in a block puts hoisted assignments
+
+    bool literal(NodeId id, int32_t& value) const;
+    void makeLiteral(NodeId id, NodeKind kind, int32_t value);
+    void makeEmpty(NodeId id);
+    void replace(NodeId id, NodeId with);
+    bool isLocal(uint32_t slot) const { return slot != UNRESOLVED && !(slot & GLOBAL_SLOT); }
+    void store(uint32_t slot, NodeId value);
+    void forget(uint32_t slot);
+    static void merge(State& into, const State& other);
+    // Marks every local assigned in the subtree
+    void assignedLocals(NodeId id, std::vector<uint8_t>& assigned) const;
+
+    // Statements
+    void statement(NodeId id);
+    void block(NodeId id);
+    void ifStatement(NodeId id);
+    void loopStatement(NodeId id, std::vector<NodeId>* hoistInto);
+
+    // Expressions, in evaluation order, so assignments update the state
+    void expression(NodeId id);
+    void binary(NodeId id);
+    void logical(NodeId id);
+
+    // Loops
+    bool isBreak(NodeId id) const;
+    std::vector<NodeId> topLevel(NodeId body) const;
+    // Facts that hold when `condition` evaluates to `truth`
+    void guardFacts(NodeId condition, bool truth, std::vector<Fact>& facts) const;
+    std::vector<uint32_t> countingVariables(NodeId loop, const State& before) const;
+    bool bound(NodeId id, const State& entry, Bound& result) const;
+    void markAccesses(NodeId id, const std::vector<Fact>& facts, const State& entry);
+    void eliminateBoundsChecks(NodeId loop, const State& entry);
+    bool invariant(NodeId id, const std::vector<uint8_t>& assigned) const;
+    void hoist(NodeId id, const std::vector<uint8_t>& assigned, std::vector<NodeId>& statements);
+
+public:
+    Optimizer(Ast& ast, ProgramInfo& info) : ast(ast), info(info) {}
+    void optimize();
+};
+
+#endif //TC3002_COMPILER_OPTIMIZER_H
@@ -0,0 +1,26 @@
+#include "BufferedWriter.h"
+#include <stdexcept>
+
+using namespace std;
+
+BufferedWriter::BufferedWriter(FILE* stream, size_t capacity) : stream(stream), capacity(capacity) {
+    if (stream) buffer.reserve(capacity);
+}
+
+BufferedWriter::~BufferedWriter() {
+    try {
+        flush();
+    } catch (const runtime_error&) {
+        // Nothing left to report to at this point
+    }
+}
+
+void BufferedWriter::flush() {
+    if (!stream || buffer.empty()) return;
+    size_t size = buffer.size();
+    size_t written = fwrite(buffer.data(), 1, size, stream);
+    buffer.clear();
+    if (written != size || fflush(stream) != 0) {
+        throw runtime_error("Could not write output");
+    }
+}
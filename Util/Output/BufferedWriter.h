@@ -0,0 +1,69 @@
+#ifndef TC3002_COMPILER_BUFFEREDWRITER_H
+#define TC3002_COMPILER_BUFFEREDWRITER_H
+
+#include <charconv>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Output accumulated in one large buffer and handed to the stream in big
+// chunks, instead of one formatted stream insertion per token. A writer
+// without a stream only collects, for output that is assembled on a worker
+// thread and written out later.
+class BufferedWriter {
+private:
+    std::string buffer;
+    FILE* stream = nullptr;
+    size_t capacity;
+
+    void reserveFor(size_t size) {
+        if (stream && buffer.size() + size > capacity) flush();
+    }
+
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+
+    // In-memory writer
+    BufferedWriter() : capacity(0) {}
+    explicit BufferedWriter(FILE* stream, size_t capacity = DEFAULT_CAPACITY);
+    ~BufferedWriter();
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    BufferedWriter& operator<<(std::string_view text) {
+        reserveFor(text.size());
+        buffer.append(text);
+        return *this;
+    }
+    BufferedWriter& operator<<(const char* text) { return *this << std::string_view(text); }
+    BufferedWriter& operator<<(const std::string& text) { return *this << std::string_view(text); }
+    BufferedWriter& operator<<(char c) {
+        reserveFor(1);
+        buffer.push_back(c);
+        return *this;
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, char>>>
+    BufferedWriter& operator<<(T value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof digits, value);
+        return *this << std::string_view(digits, result.ptr - digits);
+    }
+
+    // Raw bytes in host order, for binary output
+    template <typename T>
+    void writeRaw(T value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        reserveFor(sizeof value);
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof value);
+    }
+
+    void flush();
+    // Hands over what an in-memory writer collected
+    std::string take() { return std::move(buffer); }
+    bool empty() const { return buffer.empty(); }
+};
+
+#endif //TC3002_COMPILER_BUFFEREDWRITER_H
@@ -0,0 +1,151 @@
+#include "IncrementalParser.h"
+#include "Parser.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+static size_t unitEnd(const IncrementalParser::Unit& unit) {
+    return unit.firstToken + unit.tokenCount;
+}
+
+IncrementalParser::IncrementalParser(IncrementalLexer& lexer) : lexer(lexer) {
+    size_t start = 0;
+    for (size_t end; (end = declarationEnd(start)) != start; start = end) {
+        unitList.push_back(parseUnit(start, end));
+    }
+    lastReparsed = unitList.size();
+}
+
+size_t IncrementalParser::declarationEnd(size_t start) const {
+    // Boundaries come from the tokens alone: a var list runs to its ';', a
+    // function to the brace closing its body. An unbalanced declaration takes
+    // the rest of the file and reports its error when parsed.
+    const auto& kinds = lexer.tokens().kinds;
+    size_t i = start;
+    while (kinds[i] == TokenKind::LINE_COMMENT || kinds[i] == TokenKind::BLOCK_COMMENT) i++;
+    if (kinds[i] == TokenKind::END_OF_FILE) return start;
+
+    if (kinds[i] == TokenKind::VAR) {
+        while (kinds[i] != TokenKind::SEMICOLON && kinds[i] != TokenKind::END_OF_FILE) i++;
+        return kinds[i] == TokenKind::SEMICOLON ? i + 1 : i;
+    }
+    while (kinds[i] != TokenKind::LBRACE && kinds[i] != TokenKind::END_OF_FILE) i++;
+    size_t depth = 0;
+    for (; kinds[i] != TokenKind::END_OF_FILE; i++) {
+        if (kinds[i] == TokenKind::LBRACE) {
+            depth++;
+        } else if (kinds[i] == TokenKind::RBRACE && --depth == 0) {
+            return i + 1;
+        }
+    }
+    return i;
+}
+
+IncrementalParser::Unit IncrementalParser::parseUnit(size_t first, size_t end) const {
+    const TokenBuffer& tokens = lexer.tokens();
+    Unit unit{first, end - first, tokens.locations[first].column, Ast(), string()};
+
+    // The unit's tokens, closed by an END_OF_FILE where the next unit starts
+    TokenBuffer slice;
+    slice.reserve(end - first + 1);
+    for (size_t i = first; i < end; i++) {
+        slice.push(tokens.at(i));
+    }
+    slice.push({TokenKind::END_OF_FILE, tokens.spans[end].offset, 0,
+                tokens.locations[end].line, tokens.locations[end].column, 0});
+
+    try {
+        Parser parser(std::move(slice), lexer.source());
+        unit.ast = parser.parse();
+        unit.ast.makeRelative(tokens.spans[first].offset, tokens.locations[first].line);
+    } catch (const runtime_error& e) {
+        unit.error = e.what();
+    }
+    return unit;
+}
+
+TokenEdit IncrementalParser::apply(const TextEdit& edit) {
+    TokenEdit changed = lexer.apply(edit);
+    update(changed);
+    return changed;
+}
+
+void IncrementalParser::update(const TokenEdit& edit) {
+    const size_t newChangedEnd = edit.first + edit.insertedCount;
+    const ptrdiff_t shift = static_cast<ptrdiff_t>(edit.insertedCount) - static_cast<ptrdiff_t>(edit.removedCount);
+    lastReparsed = 0;
+
+    // Units that end before the changed tokens keep both tokens and extent
+    auto dirty = partition_point(unitList.begin(), unitList.end(),
+                                 [&](const Unit& unit) { return unitEnd(unit) <= edit.first; });
+    size_t first = static_cast<size_t>(dirty - unitList.begin());
+    size_t start = first < unitList.size() ? unitList[first].firstToken
+                 : first > 0 ? unitEnd(unitList[first - 1]) : 0;
+
+    // Re-segment from there until a new unit ends where an old one did,
+    // past the changed tokens; the old units after that one are unchanged
+    vector<Unit> fresh;
+    size_t resume = unitList.size();
+    for (size_t end; (end = declarationEnd(start)) != start; start = end) {
+        fresh.push_back(parseUnit(start, end));
+        if (end < newChangedEnd) continue;
+
+        size_t oldEnd = static_cast<size_t>(static_cast<ptrdiff_t>(end) - shift);
+        auto match = lower_bound(unitList.begin() + first, unitList.end(), oldEnd,
+                                 [](const Unit& unit, size_t value) { return unitEnd(unit) < value; });
+        if (match != unitList.end() && unitEnd(*match) == oldEnd) {
+            resume = static_cast<size_t>(match - unitList.begin()) + 1;
+            break;
+        }
+    }
+    lastReparsed = fresh.size();
+
+    // Reused units only move. A unit whose first line shifted sideways has
+    // stale columns, and one with an error has a stale message: both are
+    // parsed again.
+    const TokenBuffer& tokens = lexer.tokens();
+    for (size_t i = resume; i < unitList.size(); i++) {
+        Unit& unit = unitList[i];
+        unit.firstToken = static_cast<size_t>(static_cast<ptrdiff_t>(unit.firstToken) + shift);
+        if (!unit.error.empty() || tokens.locations[unit.firstToken].column != unit.baseColumn) {
+            unit = parseUnit(unit.firstToken, unitEnd(unit));
+            lastReparsed++;
+        }
+    }
+
+    unitList.erase(unitList.begin() + first, unitList.begin() + resume);
+    unitList.insert(unitList.begin() + first, make_move_iterator(fresh.begin()), make_move_iterator(fresh.end()));
+}
+
+bool IncrementalParser::hasErrors() const {
+    return any_of(unitList.begin(), unitList.end(), [](const Unit& unit) { return !unit.error.empty(); });
+}
+
+SourceRef IncrementalParser::refOf(const Unit& unit, NodeId id) const {
+    const TokenBuffer& tokens = lexer.tokens();
+    SourceRef ref = unit.ast.refOf(id);
+    ref.offset += tokens.spans[unit.firstToken].offset;
+    ref.line += tokens.locations[unit.firstToken].line;
+    return ref;
+}
+
+Ast IncrementalParser::merged() const {
+    const TokenBuffer& tokens = lexer.tokens();
+    Ast program;
+    size_t nodeCount = 0;
+    for (const auto& unit : unitList) nodeCount += unit.ast.size();
+    program.reserve(nodeCount + 1);
+
+    vector<NodeId> declarations;
+    for (const auto& unit : unitList) {
+        if (!unit.error.empty()) continue;
+        NodeId declaration = unit.ast.child(unit.ast.root, 0);
+        declarations.push_back(program.graft(unit.ast, declaration, tokens.spans[unit.firstToken].offset,
+                                             tokens.locations[unit.firstToken].line));
+    }
+    program.root = program.addNode(NodeKind::Program, NO_REF, declarations.data(),
+                                   static_cast<uint32_t>(declarations.size()));
+    return program;
+}
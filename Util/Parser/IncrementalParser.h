@@ -0,0 +1,52 @@
+#ifndef TC3002_COMPILER_INCREMENTALPARSER_H
+#define TC3002_COMPILER_INCREMENTALPARSER_H
+
+#include "../AST/AST.h"
+#include "../Lexer/IncrementalLexer.h"
+#include <string>
+#include <vector>
+
+// A Quetzal program is a flat list of top-level declarations, so it is kept
+// as one parse unit per declaration. After an edit only the units whose
+// tokens changed are parsed again; the others are reused as they are, which
+// makes an edit cost time proportional to the declarations it touches.
+class IncrementalParser {
+public:
+    struct Unit {
+        size_t firstToken;    // Leading comments included
+        size_t tokenCount;
+        uint32_t baseColumn;  // Column of the first token when parsed
+        Ast ast;              // Program with the one declaration, references
+                              // relative to the first token's offset and line
+        std::string error;    // Syntax error, empty when the unit parsed
+    };
+
+private:
+    IncrementalLexer& lexer;
+    std::vector<Unit> unitList;
+    size_t lastReparsed = 0;
+
+    // One past the last token of the declaration starting at or after
+    // `start`, or `start` when only comments are left
+    size_t declarationEnd(size_t start) const;
+    Unit parseUnit(size_t first, size_t end) const;
+
+public:
+    // Parses the lexer's current token stream, the lexer must outlive this
+    explicit IncrementalParser(IncrementalLexer& lexer);
+
+    // Applies an edit through the lexer and reparses what it touched
+    TokenEdit apply(const TextEdit& edit);
+    // Brings the units up to date after the lexer applied `edit`
+    void update(const TokenEdit& edit);
+
+    const std::vector<Unit>& units() const { return unitList; }
+    size_t reparsedCount() const { return lastReparsed; }  // Units parsed by the last update
+    bool hasErrors() const;
+    // Absolute location of a node of a unit
+    SourceRef refOf(const Unit& unit, NodeId id) const;
+    // Whole-program tree with absolute references, built on demand
+    Ast merged() const;
+};
+
+#endif //TC3002_COMPILER_INCREMENTALPARSER_H
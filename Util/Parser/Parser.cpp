@@ -1,26 +1,54 @@
 #include "Parser.h"
 #include "../../TokenKind/TokenKind.h"
-#include <iostream>
+#include "../Lexer/Lexer.h"
 
 using namespace std;
 
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens) {}
+Parser::Parser(TokenBuffer tokens, std::string_view source)
+    : tokens(std::move(tokens)), source(source) {
+    ast.reserve(this->tokens.size());
+}
 
-void Parser::parse() {
-    try {
-        program();
-        cout << "Parsing completed successfully!" << endl;
-    } catch (const runtime_error& e) {
-        cerr << "Parse error: " << e.what() << endl;
-        throw; // Re-throw to allow main to handle it
+Parser::Parser(const std::vector<Token>& tokens, std::string_view source) : source(source) {
+    this->tokens.reserve(tokens.size());
+    for (const auto& token : tokens) {
+        this->tokens.push(token);
     }
+    ast.reserve(tokens.size());
+}
+
+Parser::Parser(Lexer& lexer) : source(lexer.sourceText()), lexer(&lexer) {
+    fetch();
+}
+
+Ast Parser::parse(vector<string>& diagnostics) {
+    // Reporting is left to the caller, so that parsers on different threads
+    // never share a stream
+    ast.root = program();
+    diagnostics.insert(diagnostics.end(), errors.begin(), errors.end());
+    return std::move(ast);
+}
+
+Ast Parser::parse() {
+    vector<string> diagnostics;
+    Ast tree = parse(diagnostics);
+    if (!diagnostics.empty()) {
+        string message = diagnostics.front();
+        for (size_t i = 1; i < diagnostics.size(); i++) {
+            message += '\n' + diagnostics[i];
+        }
+        throw runtime_error(message);
+    }
+    return tree;
 }
 
 /* Helper Methods */
 bool Parser::match(initializer_list<TokenKind> kinds) {
     skipComments();  // Skip comments before matching
+    TokenKind next = peekKind();
+    if (next == TokenKind::END_OF_FILE) return false;
     for (auto kind : kinds) {
-        if (check(kind)) {
+        if (next == kind) {
             advance();
             return true;
         }
@@ -29,257 +57,515 @@ bool Parser::match(initializer_list<TokenKind> kinds) {
 }
 
 bool Parser::check(TokenKind kind) const {
-    if (isAtEnd()) return false;
-    return peek().kind == kind;
+    TokenKind next = peekKind();
+    return next == kind && next != TokenKind::END_OF_FILE;
+}
+
+TokenKind Parser::peekKind() const {
+    return lexer ? window[current % WINDOW_SIZE].kind : tokens.kinds[current];
 }
 
-Token Parser::advance() {
-    if (!isAtEnd()) current++;
-    return previous();
+void Parser::advance() {
+    if (!isAtEnd()) {
+        current++;
+        if (lexer) fetch();
+    }
 }
 
 Token Parser::peek() const {
-    return tokens[current];
+    return lexer ? window[current % WINDOW_SIZE] : tokens.at(current);
 }
 
 Token Parser::previous() const {
-    return tokens[current - 1];
+    return lexer ? window[(current - 1) % WINDOW_SIZE] : tokens.at(current - 1);
+}
+
+void Parser::fetch() {
+    // Keep the window filled up to the current token
+    while (fetched <= current) {
+        window[fetched % WINDOW_SIZE] = lexer->next();
+        fetched++;
+    }
 }
 
 bool Parser::isAtEnd() const {
-    return peek().kind == TokenKind::END_OF_FILE;
+    return peekKind() == TokenKind::END_OF_FILE;
 }
 
-Token Parser::consume(TokenKind kind, const string& message) {
+Token Parser::consume(TokenKind kind, const char* message) {
     skipComments();  // Skip comments before consuming
-    if (check(kind)) return advance();
+    if (check(kind)) {
+        advance();
+        return previous();
+    }
+    // The offending token stays put for the statement's recovery to skip
     error(peek(), message);
-    throw runtime_error(message);
+    return peek();
+}
+
+void Parser::error(const Token& token, string_view message) {
+    // Only the first error of a statement is reported, the rest are fallout
+    if (panicking) return;
+    panicking = true;
+    errors.push_back("[Line " + to_string(token.line) + ":" + to_string(token.column)
+                     + "] Syntax Error: " + string(message));
 }
 
-void Parser::error(const Token& token, const string& message) {
-    string errorMsg = "[Line " + to_string(token.line) + ":" + to_string(token.column)
-                    + "] Syntax Error: " + message;
-    throw runtime_error(errorMsg);
+/* Error Recovery */
+NodeId Parser::errorNode() {
+    return leaf(NodeKind::Error, NO_REF);
+}
+
+void Parser::synchronize() {
+    // Panic mode: skip to just after a ';' or a braced group, or to a '}' or
+    // a keyword that starts a statement, which the enclosing block then
+    // parses normally. Groups are skipped whole so their '}' cannot end the
+    // enclosing block early
+    panicking = false;
+    while (!isAtEnd()) {
+        switch (peekKind()) {
+            case TokenKind::SEMICOLON:
+                advance();
+                return;
+            case TokenKind::LBRACE: {
+                size_t depth = 0;
+                do {
+                    TokenKind kind = peekKind();
+                    advance();
+                    if (kind == TokenKind::LBRACE) depth++;
+                    else if (kind == TokenKind::RBRACE) depth--;
+                } while (depth > 0 && !isAtEnd());
+                return;
+            }
+            case TokenKind::RBRACE:
+            case TokenKind::VAR:
+            case TokenKind::IF:
+            case TokenKind::LOOP:
+            case TokenKind::BREAK:
+            case TokenKind::RETURN:
+            case TokenKind::INC:
+            case TokenKind::DEC:
+                return;
+            default:
+                advance();
+        }
+    }
+}
+
+void Parser::synchronizeDeclaration() {
+    // Skips the rest of a broken declaration: up to a ';' or '}' that brings
+    // the brace depth back to the top level
+    panicking = false;
+    size_t depth = 0;
+    while (!isAtEnd()) {
+        TokenKind kind = peekKind();
+        advance();
+        if (kind == TokenKind::LBRACE) {
+            depth++;
+        } else if (kind == TokenKind::RBRACE) {
+            if (depth <= 1) return;
+            depth--;
+        } else if (kind == TokenKind::SEMICOLON && depth == 0) {
+            return;
+        }
+    }
+}
+
+/* Tree Building */
+NodeId Parser::finishNode(NodeKind kind, uint32_t ref, size_t mark, int32_t value, TokenKind op) {
+    auto count = static_cast<uint32_t>(scratch.size() - mark);
+    NodeId id = ast.addNode(kind, ref, scratch.data() + mark, count, value, op);
+    scratch.resize(mark);
+    return id;
+}
+
+NodeId Parser::leaf(NodeKind kind, uint32_t ref, int32_t value, TokenKind op) {
+    return ast.addNode(kind, ref, nullptr, 0, value, op);
+}
+
+NodeId Parser::binary(TokenKind op, uint32_t ref, NodeId left, NodeId right) {
+    size_t mark = scratch.size();
+    scratch.push_back(left);
+    scratch.push_back(right);
+    return finishNode(NodeKind::Binary, ref, mark, 0, op);
 }
 
 /* Grammar Rules */
-void Parser::program() {
+NodeId Parser::program() {
+    size_t mark = scratch.size();
+    skipComments();
     while (!isAtEnd()) {
+        scratch.push_back(declaration());
+        if (panicking) synchronizeDeclaration();
         skipComments();
-        declaration();
     }
+    return finishNode(NodeKind::Program, NO_REF, mark);
 }
 
-void Parser::declaration() {
+NodeId Parser::declaration() {
     skipComments();  // Skip comments before declaration
     if (match({TokenKind::VAR})) {
-        varDeclaration();
-    } else {
-        statement();
+        return varDeclaration();
     }
+    return functionDefinition();
 }
 
-void Parser::varDeclaration() {
-    Token name = consume(TokenKind::IDENTIFIER, "Expected variable name");
-    if (match({TokenKind::ASSIGN})) {
-        expression();
+NodeId Parser::functionDefinition() {
+    if (!match({TokenKind::IDENTIFIER, TokenKind::MAIN})) {
+        error(peek(), "Expected function or variable definition");
+        return errorNode();
     }
-    consume(TokenKind::SEMICOLON, "Expected ';' after variable declaration");
+    Token name = previous();
+    uint32_t ref = ast.addRef(name);
+    consume(TokenKind::LPAREN, "Expected '(' after function name");
+
+    size_t mark = scratch.size();
+    skipComments();
+    if (!check(TokenKind::RPAREN)) {
+        do {
+            Token param = consume(TokenKind::IDENTIFIER, "Expected parameter name");
+            scratch.push_back(leaf(NodeKind::Param, ast.addRef(param), symbolOf(param)));
+        } while (match({TokenKind::COMMA}));
+    }
+    consume(TokenKind::RPAREN, "Expected ')' after parameters");
+
+    // A broken header still has its body checked, when there is one
+    if (panicking && check(TokenKind::LBRACE)) panicking = false;
+    consume(TokenKind::LBRACE, "Expected '{' before function body");
+    if (panicking) {
+        // No body to parse; the declaration is skipped as a whole
+        scratch.resize(mark);
+        return errorNode();
+    }
+    scratch.push_back(block());
+    return finishNode(NodeKind::Function, ref, mark, symbolOf(name));
 }
 
-void Parser::synchronize() {
-    advance();  // Skip the problematic token
+NodeId Parser::varDeclaration() {
+    size_t mark = scratch.size();
+    do {
+        Token name = consume(TokenKind::IDENTIFIER, "Expected variable name");
+        uint32_t ref = ast.addRef(name);
+        size_t declaratorMark = scratch.size();
+        if (match({TokenKind::ASSIGN})) {
+            scratch.push_back(expression());
+        }
+        scratch.push_back(finishNode(NodeKind::Declarator, ref, declaratorMark, symbolOf(name)));
+    } while (match({TokenKind::COMMA}));
+    consume(TokenKind::SEMICOLON, "Expected ';' after variable declaration");
+    return finishNode(NodeKind::VarDecl, NO_REF, mark);
+}
 
-    while (!isAtEnd()) {
-        skipComments();  // Skip comments during synchronization
-        if (previous().kind == TokenKind::SEMICOLON) return;
+NodeId Parser::statement() {
+    // Nested statements of one that already failed are not parsed at all
+    if (panicking) return errorNode();
 
-        switch (peek().kind) {
-            case TokenKind::VAR:
-            case TokenKind::IF:
-            case TokenKind::LOOP:
-            case TokenKind::RETURN:
-            case TokenKind::PRINTI:
-            case TokenKind::PRINTC:
-            case TokenKind::PRINTS:
-            case TokenKind::PRINTLN:
-                return;
-            default:
-                advance();
-        }
+    NodeId node = statementBody();
+    if (panicking) {
+        synchronize();
     }
+    return node;
 }
 
-void Parser::statement() {
+NodeId Parser::statementBody() {
     skipComments();
-    if (match({TokenKind::PRINTI, TokenKind::PRINTC, TokenKind::PRINTS, TokenKind::PRINTLN})) {
-        printStatement();
+    if (match({TokenKind::VAR})) {
+        return varDeclaration();
     } else if (match({TokenKind::LBRACE})) {
-        block();
+        return block();
     } else if (match({TokenKind::IF})) {
-        ifStatement();
+        return ifStatement();
     } else if (match({TokenKind::LOOP})) {
-        loopStatement();
+        return loopStatement();
+    } else if (match({TokenKind::BREAK})) {
+        return breakStatement();
     } else if (match({TokenKind::RETURN})) {
-        returnStatement();
-    } else {
-        expressionStatement();
-    }
-     try {
-        if (match({TokenKind::PRINTI, TokenKind::PRINTC, TokenKind::PRINTS, TokenKind::PRINTLN})) {
-            printStatement();
-        }
-        // ... rest of statement parsing ...
-    } catch (const runtime_error& e) {
-        synchronize();
-        throw;
+        return returnStatement();
+    } else if (match({TokenKind::INC})) {
+        return incDecStatement(NodeKind::Inc);
+    } else if (match({TokenKind::DEC})) {
+        return incDecStatement(NodeKind::Dec);
+    } else if (match({TokenKind::SEMICOLON})) {
+        return leaf(NodeKind::Empty, NO_REF);
     }
+    return expressionStatement();
 }
 
-void Parser::printStatement() {
-    TokenKind printType = previous().kind;
-    consume(TokenKind::LPAREN, "Expected '(' after print statement");
-
-    expression();
-
-    consume(TokenKind::RPAREN, "Expected ')' after expression");
-    consume(TokenKind::SEMICOLON, "Expected ';' after statement");
-}
-
-void Parser::block() {
+NodeId Parser::block() {
+    size_t mark = scratch.size();
+    skipComments();
     while (!check(TokenKind::RBRACE) && !isAtEnd()) {
-        declaration();
+        scratch.push_back(statement());
+        skipComments();
     }
     consume(TokenKind::RBRACE, "Expected '}' after block");
+    return finishNode(NodeKind::Block, NO_REF, mark);
 }
 
-void Parser::ifStatement() {
+NodeId Parser::ifStatement() {
+    size_t mark = scratch.size();
     consume(TokenKind::LPAREN, "Expected '(' after 'if'");
-    expression();
+    scratch.push_back(expression());
     consume(TokenKind::RPAREN, "Expected ')' after condition");
 
-    statement();
+    scratch.push_back(statement());
 
     while (match({TokenKind::ELIF})) {
         consume(TokenKind::LPAREN, "Expected '(' after 'elif'");
-        expression();
+        scratch.push_back(expression());
         consume(TokenKind::RPAREN, "Expected ')' after condition");
-        statement();
+        scratch.push_back(statement());
     }
 
     if (match({TokenKind::ELSE})) {
-        statement();
+        scratch.push_back(statement());
     }
+    return finishNode(NodeKind::If, NO_REF, mark);
 }
 
-void Parser::loopStatement() {
-    consume(TokenKind::LPAREN, "Expected '(' after 'loop'");
-    expression();
-    consume(TokenKind::RPAREN, "Expected ')' after condition");
-    statement();
+NodeId Parser::loopStatement() {
+    size_t mark = scratch.size();
+    // Quetzal loops are unconditional, a parenthesised condition is optional
+    if (match({TokenKind::LPAREN})) {
+        scratch.push_back(expression());
+        consume(TokenKind::RPAREN, "Expected ')' after condition");
+    }
+    scratch.push_back(statement());
+    return finishNode(NodeKind::Loop, NO_REF, mark);
+}
+
+NodeId Parser::breakStatement() {
+    uint32_t ref = ast.addRef(previous());
+    consume(TokenKind::SEMICOLON, "Expected ';' after 'break'");
+    return leaf(NodeKind::Break, ref);
 }
 
-void Parser::returnStatement() {
+NodeId Parser::returnStatement() {
+    uint32_t ref = ast.addRef(previous());
+    size_t mark = scratch.size();
+    skipComments();
     if (!check(TokenKind::SEMICOLON)) {
-        expression();
+        scratch.push_back(expression());
     }
     consume(TokenKind::SEMICOLON, "Expected ';' after return value");
+    return finishNode(NodeKind::Return, ref, mark);
+}
+
+NodeId Parser::incDecStatement(NodeKind kind) {
+    Token name = consume(TokenKind::IDENTIFIER,
+                         kind == NodeKind::Inc ? "Expected variable after 'inc'" : "Expected variable after 'dec'");
+    uint32_t ref = ast.addRef(name);
+    consume(TokenKind::SEMICOLON, "Expected ';' after statement");
+    return leaf(kind, ref, symbolOf(name));
 }
 
-void Parser::expressionStatement() {
-    expression();
+NodeId Parser::expressionStatement() {
+    size_t mark = scratch.size();
+    scratch.push_back(expression());
     consume(TokenKind::SEMICOLON, "Expected ';' after expression");
+    return finishNode(NodeKind::ExprStmt, NO_REF, mark);
 }
 
-void Parser::expression() {
-    assignment();
+NodeId Parser::expression() {
+    NodeId expr = assignment();
     skipComments();
+    return expr;
 }
 
-void Parser::assignment() {
-    logicalOr();
+NodeId Parser::assignment() {
+    NodeId target = logicalOr();
     if (match({TokenKind::ASSIGN})) {
-        assignment(); // Right-associative
+        if (ast.node(target).kind != NodeKind::Identifier) {
+            error(previous(), "Invalid assignment target");
+            return target;
+        }
+        // The target identifier is the newest node; fold it into the Assign
+        QUETZAL_COUNT(AssignmentBacktracks);
+        uint32_t ref = ast.node(target).ref;
+        int32_t symbol = ast.node(target).value;
+        ast.popNode();
+        size_t mark = scratch.size();
+        scratch.push_back(assignment()); // Right-associative
+        return finishNode(NodeKind::Assign, ref, mark, symbol);
     }
+    return target;
 }
 
-void Parser::logicalOr() {
-    logicalAnd();
+NodeId Parser::logicalOr() {
+    NodeId left = logicalAnd();
     while (match({TokenKind::OR})) {
-        logicalAnd();
+        uint32_t ref = ast.addRef(previous());
+        NodeId right = logicalAnd();
+        left = binary(TokenKind::OR, ref, left, right);
     }
+    return left;
 }
 
-void Parser::logicalAnd() {
-    equality();
+NodeId Parser::logicalAnd() {
+    NodeId left = equality();
     while (match({TokenKind::AND})) {
-        equality();
+        uint32_t ref = ast.addRef(previous());
+        NodeId right = equality();
+        left = binary(TokenKind::AND, ref, left, right);
     }
+    return left;
 }
 
-void Parser::equality() {
-    comparison();
+NodeId Parser::equality() {
+    NodeId left = comparison();
     while (match({TokenKind::EQUAL, TokenKind::NOT_EQUAL})) {
-        comparison();
+        Token op = previous();
+        NodeId right = comparison();
+        left = binary(op.kind, ast.addRef(op), left, right);
     }
+    return left;
 }
 
-void Parser::comparison() {
-    term();
+NodeId Parser::comparison() {
+    NodeId left = term();
     while (match({TokenKind::LESS, TokenKind::LESS_EQUAL, TokenKind::GREATER, TokenKind::GREATER_EQUAL})) {
-        term();
+        Token op = previous();
+        NodeId right = term();
+        left = binary(op.kind, ast.addRef(op), left, right);
     }
+    return left;
 }
 
-void Parser::term() {
-    factor();
-    while (match({TokenKind::PLUS, TokenKind::MINUS})) {
-        factor();
+NodeId Parser::term() {
+    NodeId left = factor();
+    while (true) {
+        if (match({TokenKind::PLUS, TokenKind::MINUS})) {
+            Token op = previous();
+            NodeId right = factor();
+            left = binary(op.kind, ast.addRef(op), left, right);
+        } else if (checkNegativeLiteral()) {
+            // The lexer reads "n -1" as n followed by the literal -1
+            QUETZAL_COUNT(NegativeLiteralSplits);
+            advance();
+            Token literal = previous();
+            uint32_t ref = ast.addRef(literal);
+            NodeId right = factorTail(leaf(NodeKind::IntLiteral, ref, intLiteralValue(literal, true)));
+            left = binary(TokenKind::MINUS, ref, left, right);
+        } else {
+            return left;
+        }
     }
 }
 
-void Parser::factor() {
-    unary();
+NodeId Parser::factor() {
+    return factorTail(unary());
+}
+
+NodeId Parser::factorTail(NodeId left) {
     while (match({TokenKind::ASTERISK, TokenKind::SLASH, TokenKind::PERCENT})) {
-        unary();
+        Token op = previous();
+        NodeId right = unary();
+        left = binary(op.kind, ast.addRef(op), left, right);
     }
+    return left;
 }
 
-void Parser::unary() {
-    if (match({TokenKind::NOT, TokenKind::MINUS})) {
-        unary();
-    } else {
-        primary();
+NodeId Parser::unary() {
+    if (match({TokenKind::NOT, TokenKind::MINUS, TokenKind::PLUS})) {
+        Token op = previous();
+        uint32_t ref = ast.addRef(op);
+        size_t mark = scratch.size();
+        scratch.push_back(unary());
+        return finishNode(NodeKind::Unary, ref, mark, 0, op.kind);
     }
+    return primary();
 }
 
-void Parser::primary() {
-    if (match({TokenKind::FALSE})) return;
-    if (match({TokenKind::TRUE})) return;
-    if (match({TokenKind::LIT_INT})) return;
-    if (match({TokenKind::LIT_STR})) return;
+NodeId Parser::primary() {
+    if (panicking) return errorNode();
+    if (match({TokenKind::LIT_INT})) {
+        return leaf(NodeKind::IntLiteral, ast.addRef(previous()), intLiteralValue(previous(), false));
+    }
+    if (match({TokenKind::LIT_CHAR})) {
+        Token literal = previous();
+        return leaf(NodeKind::CharLiteral, ast.addRef(literal),
+                    Lexer::decodeChar(tokenText(literal, source)));
+    }
+    if (match({TokenKind::LIT_BOOL})) {
+        Token literal = previous();
+        return leaf(NodeKind::BoolLiteral, ast.addRef(literal), source[literal.offset] == 't');
+    }
+    if (match({TokenKind::LIT_STR})) {
+        return leaf(NodeKind::StringLiteral, ast.addRef(previous()));
+    }
+    if (match({TokenKind::LBRACKET})) {
+        return arguments(NodeKind::ArrayLiteral, ast.addRef(previous()), TokenKind::UNKNOWN,
+                         TokenKind::RBRACKET, "Expected ']' after array elements");
+    }
 
     if (match({TokenKind::IDENTIFIER})) {
         // Variable reference or function call
+        Token name = previous();
+        uint32_t ref = ast.addRef(name);
         if (match({TokenKind::LPAREN})) {
-            // Function call
-            if (!check(TokenKind::RPAREN)) {
-                do {
-                    expression();
-                } while (match({TokenKind::COMMA}));
-            }
-            consume(TokenKind::RPAREN, "Expected ')' after arguments");
+            return arguments(NodeKind::Call, ref, TokenKind::UNKNOWN, TokenKind::RPAREN,
+                             "Expected ')' after arguments", symbolOf(name));
         }
-        return;
+        return leaf(NodeKind::Identifier, ref, symbolOf(name));
+    }
+
+    if (match({TokenKind::MAIN})) {
+        Token name = previous();
+        uint32_t ref = ast.addRef(name);
+        consume(TokenKind::LPAREN, "Expected '(' after 'main'");
+        return arguments(NodeKind::Call, ref, TokenKind::UNKNOWN, TokenKind::RPAREN,
+                         "Expected ')' after arguments", symbolOf(name));
+    }
+
+    if (match({TokenKind::PRINTI, TokenKind::PRINTC, TokenKind::PRINTS, TokenKind::PRINTLN,
+               TokenKind::READI, TokenKind::READS, TokenKind::NEW, TokenKind::SIZE,
+               TokenKind::ADD, TokenKind::GET, TokenKind::SET})) {
+        Token api = previous();
+        uint32_t ref = ast.addRef(api);
+        skipComments();
+        if (!match({TokenKind::LPAREN})) {
+            // Message built only on the error path
+            error(peek(), "Expected '(' after '" + string(tokenText(api, source)) + "'");
+        }
+        return arguments(NodeKind::ApiCall, ref, api.kind, TokenKind::RPAREN, "Expected ')' after arguments");
     }
 
     if (match({TokenKind::LPAREN})) {
-        expression();
+        NodeId expr = expression();
         consume(TokenKind::RPAREN, "Expected ')' after expression");
-        return;
+        return expr;
     }
 
     error(peek(), "Expected expression");
+    return errorNode();
+}
+
+NodeId Parser::arguments(NodeKind kind, uint32_t ref, TokenKind op, TokenKind closer, const char* message,
+                         int32_t value) {
+    size_t mark = scratch.size();
+    skipComments();
+    if (!check(closer)) {
+        do {
+            scratch.push_back(expression());
+        } while (match({TokenKind::COMMA}));
+    }
+    consume(closer, message);
+    return finishNode(kind, ref, mark, value, op);
 }
 
+int32_t Parser::intLiteralValue(const Token& token, bool negate) {
+    // Quetzal integers are 32 bits wide
+    int64_t value = token.intValue;
+    if (value >= INT32_MIN && value <= INT32_MAX && negate) {
+        value = -value;
+    }
+    if (value < INT32_MIN || value > INT32_MAX) {
+        error(token, "Integer literal out of range");
+    }
+    return static_cast<int32_t>(value);
+}
+
+bool Parser::checkNegativeLiteral() {
+    skipComments();
+    return check(TokenKind::LIT_INT) && source[peek().offset] == '-';
+}
@@ -2,63 +2,114 @@
 #define TC3002_COMPILER_PARSER_H
 
 #include "../../Token/Token.h"
+#include "../../Token/TokenBuffer.h"
+#include "../AST/AST.h"
+#include "../Instrumentation/Instrumentation.h"
 #include <vector>
 #include <memory>
 #include <stdexcept>
+#include <string_view>
 #include <initializer_list>
 
+class Lexer;
+
 class Parser {
 private:
-    std::vector<Token> tokens;
+    TokenBuffer tokens;
+    std::string_view source;
     size_t current = 0;
 
-    // Helper methods
+    // Streaming mode: tokens are pulled from the lexer on demand into a small
+    // ring, so only the lookahead window is ever held in memory
+    static constexpr size_t WINDOW_SIZE = 4;  // Power of two, >= 2 for previous()
+    Lexer* lexer = nullptr;
+    Token window[WINDOW_SIZE];
+    size_t fetched = 0;  // Tokens pulled from the lexer so far
+    void fetch();
+
+    // Tree under construction; scratch collects a node's children until the
+    // node itself is created, so that child lists end up contiguous
+    Ast ast;
+    std::vector<NodeId> scratch;
+    NodeId finishNode(NodeKind kind, uint32_t ref, size_t mark,
+                      int32_t value = 0, TokenKind op = TokenKind::UNKNOWN);
+    NodeId leaf(NodeKind kind, uint32_t ref, int32_t value = 0, TokenKind op = TokenKind::UNKNOWN);
+    NodeId binary(TokenKind op, uint32_t ref, NodeId left, NodeId right);
+
+    // Helper methods. Lookahead only reads token kinds; whole tokens are
+    // assembled by peek()/previous() when a rule needs their text or location
     bool match(std::initializer_list<TokenKind> kinds);
     bool check(TokenKind kind) const;
-    Token advance();
+    TokenKind peekKind() const;
+    void advance();
     Token peek() const;
     Token previous() const;
     bool isAtEnd() const;
 
-    // Error handling
-    Token consume(TokenKind kind, const std::string& message);
-    void error(const Token& token, const std::string& message);
+    // Error handling. Errors are collected rather than thrown: the first one
+    // puts the parser in panic mode, which suppresses the cascade that follows
+    // until the enclosing statement or declaration resynchronizes
+    std::vector<std::string> errors;
+    bool panicking = false;
+    Token consume(TokenKind kind, const char* message);
+    void error(const Token& token, std::string_view message);
+    NodeId errorNode();
+    void synchronize();
+    void synchronizeDeclaration();
 
     // Grammar rules
-    void program();
-    void declaration();
-    void varDeclaration();
-    void statement();
-    void synchronize();
-    
+    NodeId program();
+    NodeId declaration();
+    NodeId functionDefinition();
+    NodeId varDeclaration();
+    NodeId statement();
+    NodeId statementBody();
+
     // Statements
-    void printStatement();
-    void block();
-    void ifStatement();
-    void loopStatement();
-    void returnStatement();
-    void expressionStatement();
-    
+    NodeId block();
+    NodeId ifStatement();
+    NodeId loopStatement();
+    NodeId breakStatement();
+    NodeId returnStatement();
+    NodeId incDecStatement(NodeKind kind);
+    NodeId expressionStatement();
+
     // Expressions
-    void expression();
-    void assignment();
-    void logicalOr();
-    void logicalAnd();
-    void equality();
-    void comparison();
-    void term();
-    void factor();
-    void unary();
-    void primary();
+    NodeId expression();
+    NodeId assignment();
+    NodeId logicalOr();
+    NodeId logicalAnd();
+    NodeId equality();
+    NodeId comparison();
+    NodeId term();
+    NodeId factor();
+    NodeId factorTail(NodeId left);
+    NodeId unary();
+    NodeId primary();
+    NodeId arguments(NodeKind kind, uint32_t ref, TokenKind op, TokenKind closer, const char* message,
+                     int32_t value = 0);
+    int32_t intLiteralValue(const Token& token, bool negate);
+    // Symbol ID the lexer gave a name token, NO_SYMBOL when it did not intern
+    static int32_t symbolOf(const Token& token) { return static_cast<int32_t>(token.intValue); }
+    bool checkNegativeLiteral();
     void skipComments() {
-        while (check(TokenKind::LINE_COMMENT) || check(TokenKind::BLOCK_COMMENT)) {
+        QUETZAL_COUNT(SkipCommentsCalls);
+        while (peekKind() == TokenKind::LINE_COMMENT || peekKind() == TokenKind::BLOCK_COMMENT) {
+            QUETZAL_COUNT(CommentsSkipped);
             advance();
         }
     }
 
 public:
-    Parser(const std::vector<Token>& tokens);
-    void parse();
+    Parser(TokenBuffer tokens, std::string_view source);
+    Parser(const std::vector<Token>& tokens, std::string_view source);
+    // Streaming mode, the lexer must outlive the parser
+    Parser(Lexer& lexer);
+    // Parses the whole program and hands over its syntax tree, appending every
+    // syntax error to diagnostics; broken constructs become Error nodes
+    Ast parse(std::vector<std::string>& diagnostics);
+    // Same, but throws a runtime_error listing all syntax errors, if any
+    Ast parse();
 };
 
-#endif //TC3002_COMPILER_PARSER_H
\ No newline at end of file
+#endif //TC3002_COMPILER_PARSER_H
@@ -0,0 +1,169 @@
+#include "ArrayStore.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+ArrayStore::~ArrayStore() {
+    for (Record& record : records) {
+        if (record.ownsBlock()) free(record.data);
+    }
+}
+
+void ArrayStore::handleError(int32_t handle) {
+    throw runtime_error("Invalid array handle " + to_string(handle));
+}
+
+void ArrayStore::indexError(int32_t index, int32_t size) {
+    throw runtime_error("Index " + to_string(index) + " out of bounds for array of size " + to_string(size));
+}
+
+int32_t ArrayStore::allocate(int32_t capacity) {
+    int32_t* block = nullptr;
+    if (capacity > INLINE_CAPACITY) {
+        block = static_cast<int32_t*>(calloc(static_cast<size_t>(capacity), sizeof(int32_t)));
+        if (block == nullptr) throw runtime_error("Out of memory");
+    }
+
+    int32_t handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+        records[handle] = {};
+    } else {
+        if (records.size() == records.capacity()) {
+            if (records.size() >= static_cast<size_t>(INT32_MAX)) {
+                free(block);
+                throw runtime_error("Out of memory");
+            }
+            records.reserve(records.empty() ? 64 : records.size() * 2);
+            // Inline elements moved with their records
+            for (Record& record : records) {
+                if (record.isInline()) record.data = record.elements;
+            }
+        }
+        handle = static_cast<int32_t>(records.size());
+        records.push_back({});
+    }
+
+    Record& record = records[handle];
+    if (block == nullptr) {
+        record.data = record.elements;
+        record.capacity = INLINE_CAPACITY;
+    } else {
+        record.data = block;
+        record.capacity = capacity;
+    }
+    heapBytes += record.footprint();
+    return handle;
+}
+
+int32_t ArrayStore::create(int32_t size) {
+    if (size < 0) {
+        throw runtime_error("Negative array size " + to_string(size));
+    }
+    int32_t handle = allocate(size);
+    records[handle].size = size;  // Zeroed either way
+    return handle;
+}
+
+int32_t ArrayStore::create(const int32_t* values, size_t count) {
+    if (count > static_cast<size_t>(INT32_MAX)) throw runtime_error("Out of memory");
+    int32_t handle = allocate(static_cast<int32_t>(count));
+    Record& record = records[handle];
+    if (count > 0) memcpy(record.data, values, count * sizeof(int32_t));
+    record.size = static_cast<int32_t>(count);
+    return handle;
+}
+
+int32_t ArrayStore::createShared(const int32_t* values, size_t count) {
+    if (count <= static_cast<size_t>(INLINE_CAPACITY)) return create(values, count);
+    if (count > static_cast<size_t>(INT32_MAX)) throw runtime_error("Out of memory");
+    int32_t handle = allocate(0);
+    Record& record = records[handle];
+    record.data = const_cast<int32_t*>(values);  // Only read until unshare()
+    record.size = static_cast<int32_t>(count);
+    record.capacity = SHARED;
+    return handle;
+}
+
+void ArrayStore::unshare(int32_t handle) {
+    Record& record = records[handle];
+    if (record.capacity == 0) handleError(handle);
+    // Shared records are never inline, so the copy gets a block of its own
+    auto* data = static_cast<int32_t*>(malloc(static_cast<size_t>(record.size) * sizeof(int32_t)));
+    if (data == nullptr) throw runtime_error("Out of memory");
+    memcpy(data, record.data, static_cast<size_t>(record.size) * sizeof(int32_t));
+    heapBytes -= record.footprint();
+    record.data = data;
+    record.capacity = record.size;
+    heapBytes += record.footprint();
+}
+
+void ArrayStore::add(int32_t handle, int32_t value) {
+    Record& record = writable(handle);
+    if (record.size == record.capacity) {
+        // Geometric growth keeps add() amortised O(1)
+        if (record.size == INT32_MAX) throw runtime_error("Out of memory");
+        int32_t capacity = record.capacity <= INT32_MAX / 2 ? record.capacity * 2 : INT32_MAX;
+        size_t bytes = static_cast<size_t>(capacity) * sizeof(int32_t);
+        auto* data = static_cast<int32_t*>(record.isInline() ? malloc(bytes) : realloc(record.data, bytes));
+        if (data == nullptr) throw runtime_error("Out of memory");
+        if (record.isInline()) memcpy(data, record.elements, sizeof(record.elements));
+        heapBytes -= record.footprint();
+        record.data = data;
+        record.capacity = capacity;
+        heapBytes += record.footprint();
+    }
+    record.data[record.size++] = value;
+}
+
+/* Collection */
+void ArrayStore::mark(int32_t value) {
+    auto handle = static_cast<uint32_t>(value);
+    if (handle < records.size() && records[handle].capacity != 0 && !marks[handle]) {
+        marks[handle] = 1;
+        pending.push_back(value);
+    }
+}
+
+void ArrayStore::collect(Roots roots) {
+    auto start = chrono::steady_clock::now();
+
+    // Mark: the roots, then the elements of every array found, transitively
+    marks.assign(records.size(), 0);
+    for (const auto& range : roots) {
+        for (const int32_t* value = range.first; value < range.second; value++) mark(*value);
+    }
+    while (!pending.empty()) {
+        const Record& record = records[pending.back()];
+        pending.pop_back();
+        for (int32_t i = 0; i < record.size; i++) mark(record.data[i]);
+    }
+
+    // Sweep: unmarked records release their block and join the free list
+    for (size_t handle = 0; handle < records.size(); handle++) {
+        Record& record = records[handle];
+        if (marks[handle] || record.capacity == 0) continue;
+        size_t bytes = record.footprint();
+        if (record.ownsBlock()) free(record.data);
+        record = {};
+        record.data = record.elements;
+        heapBytes -= bytes;
+        stats.bytesReclaimed += bytes;
+        stats.arraysReclaimed++;
+        freeHandles.push_back(static_cast<int32_t>(handle));
+    }
+
+    // The heap may double before the next collection, so its cost stays
+    // proportional to the allocation that triggers it
+    nextCollection = max(MIN_COLLECTION_BYTES, heapBytes * 2);
+    double pause = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stats.collections++;
+    stats.pauseSeconds += pause;
+    stats.longestPauseSeconds = max(stats.longestPauseSeconds, pause);
+}
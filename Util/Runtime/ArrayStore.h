@@ -0,0 +1,133 @@
+#ifndef TC3002_COMPILER_ARRAYSTORE_H
+#define TC3002_COMPILER_ARRAYSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+// Runtime storage behind Quetzal's array handles. A handle indexes a dense
+// table of 32-byte records, { data, size, capacity } followed by room for
+// INLINE_CAPACITY elements: short arrays (most strings' words, small
+// literals) live inside their record, longer ones in one heap block that
+// add() grows geometrically. get and set are inline: load the record, compare
+// handle and index unsigned, load or store the element. Every operation
+// checks its handle and index and throws a runtime_error on misuse.
+//
+// A string literal's array may share its elements with the program's
+// constant pool (createShared). The first set or add copies them out, so
+// literals stay immutable while each evaluation still acts as a fresh array.
+//
+// Unreachable arrays are reclaimed by collect(), a non-moving mark-sweep the
+// owner runs when collectionDue(). Quetzal values carry no types, so marking
+// is conservative: any root or element equal to a live handle keeps that
+// array, and the arrays it reaches, alive. Freed handles are reused. Only a
+// handle the program computes, rather than one it kept, can be cut loose.
+class ArrayStore {
+public:
+    static constexpr int32_t INLINE_CAPACITY = 4;
+    static constexpr int32_t SHARED = -1;  // Capacity of a record on constant elements
+    // Heap size below which no collection runs
+    static constexpr size_t MIN_COLLECTION_BYTES = 1 << 20;
+
+    struct Statistics {
+        uint64_t collections = 0;
+        uint64_t arraysReclaimed = 0;
+        uint64_t bytesReclaimed = 0;
+        double pauseSeconds = 0;         // All collections together
+        double longestPauseSeconds = 0;
+    };
+
+    // Values to scan for handles, as [first, last) ranges
+    using Roots = std::initializer_list<std::pair<const int32_t*, const int32_t*>>;
+
+private:
+    struct Record {
+        int32_t* data;      // The inline elements or a heap block
+        int32_t size;
+        int32_t capacity;   // INLINE_CAPACITY while inline, SHARED, or 0 once freed
+        int32_t elements[INLINE_CAPACITY];
+
+        bool isInline() const { return capacity == INLINE_CAPACITY; }
+        bool ownsBlock() const { return capacity > INLINE_CAPACITY; }
+        size_t footprint() const { return sizeof(Record) + (ownsBlock() ? capacity * sizeof(int32_t) : 0); }
+    };
+
+    std::vector<Record> records;
+    std::vector<int32_t> freeHandles;
+    size_t heapBytes = 0;                      // Footprint of the live records
+    size_t nextCollection = MIN_COLLECTION_BYTES;
+    std::vector<uint8_t> marks;                // Kept between collections
+    std::vector<int32_t> pending;
+    Statistics stats;
+
+    // Handle of a new record, empty with inline storage, or with a heap
+    // block of `capacity` zeros
+    int32_t allocate(int32_t capacity);
+    void mark(int32_t value);
+    // Gives a shared record its own copy of the elements
+    void unshare(int32_t handle);
+    [[noreturn]] static void handleError(int32_t handle);
+    [[noreturn]] static void indexError(int32_t index, int32_t size);
+
+    Record& at(int32_t handle) {
+        if (static_cast<uint32_t>(handle) >= records.size() || records[handle].capacity == 0) {
+            handleError(handle);
+        }
+        return records[handle];
+    }
+    const Record& at(int32_t handle) const { return const_cast<ArrayStore*>(this)->at(handle); }
+    // For writes: one compare covers both freed and shared records
+    Record& writable(int32_t handle) {
+        if (static_cast<uint32_t>(handle) >= records.size()) handleError(handle);
+        if (records[handle].capacity <= 0) unshare(handle);
+        return records[handle];
+    }
+
+public:
+    ArrayStore() = default;
+    ArrayStore(const ArrayStore&) = delete;
+    ArrayStore& operator=(const ArrayStore&) = delete;
+    ~ArrayStore();
+
+    // new(size): size zeros
+    int32_t create(int32_t size);
+    // A copy of the given elements, for literals and reads()
+    int32_t create(const int32_t* values, size_t count);
+    // An array over `values`, which must outlive the store and are never
+    // written. Copied at once if short enough to be inline.
+    int32_t createShared(const int32_t* values, size_t count);
+
+    int32_t size(int32_t handle) const { return at(handle).size; }
+    void add(int32_t handle, int32_t value);
+    int32_t get(int32_t handle, int32_t index) const {
+        const Record& record = at(handle);
+        // Unsigned, so negative indices fail too
+        if (static_cast<uint32_t>(index) >= static_cast<uint32_t>(record.size)) indexError(index, record.size);
+        return record.data[index];
+    }
+    void set(int32_t handle, int32_t index, int32_t value) {
+        Record& record = writable(handle);
+        if (static_cast<uint32_t>(index) >= static_cast<uint32_t>(record.size)) indexError(index, record.size);
+        record.data[index] = value;
+    }
+    // Unchecked, for accesses the optimiser proved valid (see IN_BOUNDS)
+    int32_t getUnchecked(int32_t handle, int32_t index) const { return records[handle].data[index]; }
+    void setUnchecked(int32_t handle, int32_t index, int32_t value) {
+        if (records[handle].capacity < 0) unshare(handle);
+        records[handle].data[index] = value;
+    }
+    // Contiguous view of the elements, valid until the array grows
+    const int32_t* data(int32_t handle) const { return at(handle).data; }
+
+    // Handles ever allocated, freed ones included
+    size_t count() const { return records.size(); }
+
+    bool collectionDue() const { return heapBytes >= nextCollection; }
+    // Frees every array not reachable from a value in `roots`
+    void collect(Roots roots);
+    const Statistics& statistics() const { return stats; }
+};
+
+#endif //TC3002_COMPILER_ARRAYSTORE_H
@@ -0,0 +1,236 @@
+#include "SemanticAnalyzer.h"
+#include <algorithm>
+
+using namespace std;
+
+int apiArity(TokenKind api) {
+    switch (api) {
+        case TokenKind::PRINTLN:
+        case TokenKind::READI:
+        case TokenKind::READS:
+            return 0;
+        case TokenKind::PRINTI:
+        case TokenKind::PRINTC:
+        case TokenKind::PRINTS:
+        case TokenKind::NEW:
+        case TokenKind::SIZE:
+            return 1;
+        case TokenKind::ADD:
+        case TokenKind::GET:
+            return 2;
+        case TokenKind::SET:
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+SemanticAnalyzer::SemanticAnalyzer(const Ast& ast, string_view source, Interner& symbols)
+    : ast(ast), source(source), symbols(symbols) {
+    bindingSlot.assign(symbols.size(), UNRESOLVED);
+    bindingDepth.assign(symbols.size(), 0);
+    functionIndex.assign(symbols.size(), UNRESOLVED);
+}
+
+ProgramInfo SemanticAnalyzer::analyze(vector<string>& diagnostics) {
+    this->diagnostics = &diagnostics;
+    info.slots.assign(ast.size(), UNRESOLVED);
+    if (ast.root == NO_NODE) return std::move(info);
+
+    collectDeclarations();
+    for (size_t i = 0; i < info.functions.size(); i++) {
+        checkFunction(i);
+    }
+    return std::move(info);
+}
+
+/* Helpers */
+SymbolId SemanticAnalyzer::nameOf(NodeId id) {
+    SymbolId name = ast.symbol(id);
+    if (name == NO_SYMBOL) {
+        name = symbols.intern(ast.text(id, source));
+    }
+    if (name >= bindingSlot.size()) {
+        bindingSlot.resize(symbols.size(), UNRESOLVED);
+        bindingDepth.resize(symbols.size(), 0);
+        functionIndex.resize(symbols.size(), UNRESOLVED);
+    }
+    return name;
+}
+
+void SemanticAnalyzer::error(NodeId id, const string& message) {
+    string location;
+    if (id != NO_NODE && ast.node(id).ref != NO_REF) {
+        const SourceRef& ref = ast.refOf(id);
+        location = "[Line " + to_string(ref.line) + ":" + to_string(ref.column) + "] ";
+    }
+    diagnostics->push_back(location + "Semantic Error: " + message);
+}
+
+/* Scopes */
+void SemanticAnalyzer::openScope() {
+    scopes.push_back({NO_SYMBOL, nextSlot, 0});
+    depth++;
+}
+
+void SemanticAnalyzer::closeScope() {
+    // Pops back to the marker, unshadowing whatever this scope declared
+    while (scopes.back().name != NO_SYMBOL) {
+        const ScopeEntry& entry = scopes.back();
+        bindingSlot[entry.name] = entry.shadowedSlot;
+        bindingDepth[entry.name] = entry.shadowedDepth;
+        scopes.pop_back();
+    }
+    // Slots of the closed scope are free for its siblings
+    nextSlot = scopes.back().shadowedSlot;
+    scopes.pop_back();
+    depth--;
+}
+
+void SemanticAnalyzer::declare(NodeId id, uint32_t slot) {
+    SymbolId name = nameOf(id);
+    if (bindingSlot[name] != UNRESOLVED && bindingDepth[name] == depth) {
+        error(id, "Duplicate variable '" + string(ast.text(id, source)) + "'");
+        info.slots[id] = bindingSlot[name];
+        return;
+    }
+    scopes.push_back({name, bindingSlot[name], bindingDepth[name]});
+    bindingSlot[name] = slot;
+    bindingDepth[name] = depth;
+    info.slots[id] = slot;
+}
+
+uint32_t SemanticAnalyzer::lookup(NodeId id) {
+    uint32_t slot = bindingSlot[nameOf(id)];
+    if (slot == UNRESOLVED) {
+        error(id, "Undeclared variable '" + string(ast.text(id, source)) + "'");
+    }
+    info.slots[id] = slot;
+    return slot;
+}
+
+/* Passes */
+void SemanticAnalyzer::collectDeclarations() {
+    // Globals and the function table first, so every body sees all of them
+    const NodeId* declarations = ast.children(ast.root);
+    uint32_t count = ast.node(ast.root).count;
+    for (uint32_t i = 0; i < count; i++) {
+        NodeId id = declarations[i];
+        const Node& n = ast.node(id);
+        if (n.kind == NodeKind::VarDecl) {
+            for (uint32_t d = 0; d < n.count; d++) {
+                NodeId declarator = ast.child(id, d);
+                auto slot = static_cast<uint32_t>(GLOBAL_SLOT | info.globals.size());
+                info.globals.push_back(declarator);
+                declare(declarator, slot);
+            }
+        } else if (n.kind == NodeKind::Function) {
+            SymbolId name = nameOf(id);
+            if (functionIndex[name] != UNRESOLVED) {
+                error(id, "Duplicate function '" + string(ast.text(id, source)) + "'");
+                continue;
+            }
+            functionIndex[name] = static_cast<uint32_t>(info.functions.size());
+            info.slots[id] = functionIndex[name];
+            info.functions.push_back({name, id, n.count - 1, 0});
+            if (ast.text(id, source) == "main") {
+                info.mainFunction = functionIndex[name];
+                if (n.count > 1) error(id, "'main' must not take parameters");
+            }
+        }
+    }
+    if (info.mainFunction == UNRESOLVED) {
+        error(NO_NODE, "Missing 'main' function");
+    }
+
+    // Global initializers may call any function and read any global
+    for (NodeId declarator : info.globals) {
+        visitChildren(declarator);
+    }
+}
+
+void SemanticAnalyzer::checkFunction(size_t index) {
+    FunctionInfo& function = info.functions[index];
+    const Node& n = ast.node(function.node);
+    nextSlot = 0;
+    frameSize = 0;
+    loopDepth = 0;
+
+    // Parameters and the body's top-level locals share one scope
+    openScope();
+    for (uint32_t i = 0; i < function.paramCount; i++) {
+        declare(ast.child(function.node, i), nextSlot++);
+    }
+    frameSize = nextSlot;
+    visitChildren(ast.child(function.node, n.count - 1));
+    closeScope();
+    function.frameSize = frameSize;
+}
+
+void SemanticAnalyzer::visitChildren(NodeId id) {
+    const Node& n = ast.node(id);
+    for (uint32_t i = 0; i < n.count; i++) {
+        visit(ast.child(id, i));
+    }
+}
+
+void SemanticAnalyzer::visit(NodeId id) {
+    const Node& n = ast.node(id);
+    switch (n.kind) {
+        case NodeKind::Block:
+            openScope();
+            visitChildren(id);
+            closeScope();
+            break;
+        case NodeKind::Declarator:
+            // The initializer is checked before the name comes into scope
+            visitChildren(id);
+            declare(id, nextSlot++);
+            frameSize = max(frameSize, nextSlot);
+            break;
+        case NodeKind::Loop:
+            loopDepth++;
+            visitChildren(id);
+            loopDepth--;
+            break;
+        case NodeKind::Break:
+            if (loopDepth == 0) error(id, "'break' outside of a loop");
+            break;
+        case NodeKind::Identifier:
+        case NodeKind::Inc:
+        case NodeKind::Dec:
+            lookup(id);
+            break;
+        case NodeKind::Assign:
+            visitChildren(id);
+            lookup(id);
+            break;
+        case NodeKind::Call: {
+            visitChildren(id);
+            uint32_t function = functionIndex[nameOf(id)];
+            info.slots[id] = function;
+            if (function == UNRESOLVED) {
+                error(id, "Undeclared function '" + string(ast.text(id, source)) + "'");
+            } else if (n.count != info.functions[function].paramCount) {
+                error(id, "Function '" + string(ast.text(id, source)) + "' expects "
+                          + to_string(info.functions[function].paramCount) + " argument(s), got "
+                          + to_string(n.count));
+            }
+            break;
+        }
+        case NodeKind::ApiCall: {
+            visitChildren(id);
+            int arity = apiArity(n.op);
+            if (arity >= 0 && n.count != static_cast<uint32_t>(arity)) {
+                error(id, "'" + string(ast.text(id, source)) + "' expects " + to_string(arity)
+                          + " argument(s), got " + to_string(n.count));
+            }
+            break;
+        }
+        case NodeKind::Error:
+            break;
+        default:
+            visitChildren(id);
+            break;
+    }
+}
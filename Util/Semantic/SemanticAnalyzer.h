@@ -0,0 +1,93 @@
+#ifndef TC3002_COMPILER_SEMANTICANALYZER_H
+#define TC3002_COMPILER_SEMANTICANALYZER_H
+
+#include "../AST/AST.h"
+#include "../Interner/Interner.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Variable slots: locals are numbered per function from 0 (parameters
+// first), globals are numbered program-wide and carry GLOBAL_SLOT
+constexpr uint32_t GLOBAL_SLOT = 0x80000000u;
+constexpr uint32_t UNRESOLVED = UINT32_MAX;
+
+struct FunctionInfo {
+    SymbolId name;
+    NodeId node;           // The Function node
+    uint32_t paramCount;
+    uint32_t frameSize;    // Local slots needed, parameters included
+};
+
+// What the analysis resolved, for the phases after it
+struct ProgramInfo {
+    std::vector<FunctionInfo> functions;  // In declaration order
+    std::vector<NodeId> globals;          // Declarator of each global slot
+    // Per node: the variable slot of Param, Declarator, Identifier, Assign,
+    // Inc and Dec nodes, the function index of Call nodes, UNRESOLVED otherwise
+    std::vector<uint32_t> slots;
+    uint32_t mainFunction = UNRESOLVED;
+};
+
+// Arguments taken by an API function (PRINTI...SET)
+int apiArity(TokenKind api);
+
+// Checks names and call shapes: undeclared and duplicate variables and
+// functions, arity of user and API calls, 'break' outside a loop, and a
+// parameterless 'main'. Functions are all entered in a table before any body
+// is checked, so calls may come before the definition.
+//
+// Scopes are one flat stack: opening a block pushes a marker entry, each
+// declaration pushes an entry recording the binding it shadows, and closing
+// the block pops back to the marker, restoring those bindings. The current
+// binding of every name sits in arrays indexed by symbol ID, so a lookup is a
+// single load and the whole pass is linear in the size of the tree, with no
+// allocation per scope once the stack has grown to the deepest nesting.
+class SemanticAnalyzer {
+private:
+    struct ScopeEntry {
+        SymbolId name;          // NO_SYMBOL for a scope marker
+        uint32_t shadowedSlot;  // Marker: the slot counter to restore
+        uint32_t shadowedDepth;
+    };
+
+    const Ast& ast;
+    std::string_view source;
+    Interner& symbols;
+    std::vector<std::string>* diagnostics = nullptr;
+    ProgramInfo info;
+
+    std::vector<ScopeEntry> scopes;
+    std::vector<uint32_t> bindingSlot;   // Per symbol, UNRESOLVED when unbound
+    std::vector<uint32_t> bindingDepth;  // Per symbol, scope depth of the binding
+    std::vector<uint32_t> functionIndex; // Per symbol, UNRESOLVED when no such function
+    uint32_t depth = 0;                  // 0 is the global scope
+    uint32_t nextSlot = 0;
+    uint32_t frameSize = 0;
+    uint32_t loopDepth = 0;
+
+    SymbolId nameOf(NodeId id);
+    void error(NodeId id, const std::string& message);
+
+    // Scopes
+    void openScope();
+    void closeScope();
+    void declare(NodeId id, uint32_t slot);
+    uint32_t lookup(NodeId id);
+
+    // Passes
+    void collectDeclarations();
+    void checkFunction(size_t index);
+    void visit(NodeId id);
+    void visitChildren(NodeId id);
+
+public:
+    // The interner must be the one the lexer used; names lexed without one
+    // are interned here on first use
+    SemanticAnalyzer(const Ast& ast, std::string_view source, Interner& symbols);
+    // Appends every semantic error to diagnostics and returns the resolution
+    ProgramInfo analyze(std::vector<std::string>& diagnostics);
+};
+
+#endif //TC3002_COMPILER_SEMANTICANALYZER_H
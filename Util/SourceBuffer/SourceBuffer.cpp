@@ -0,0 +1,132 @@
+#include "SourceBuffer.h"
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifndef _WIN32
+// Reads everything left on a descriptor, used for pipes and stdin
+static string readDescriptor(int fd, const string& filePath) {
+    string contents;
+    size_t used = 0;
+    contents.resize(64 * 1024);
+    while (true) {
+        if (used == contents.size()) {
+            contents.resize(contents.size() * 2);
+        }
+        ssize_t count = ::read(fd, &contents[used], contents.size() - used);
+        if (count == 0) break;
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error("Could not read file: " + filePath);
+        }
+        used += static_cast<size_t>(count);
+    }
+    contents.resize(used);
+    return contents;
+}
+#endif
+
+SourceBuffer SourceBuffer::fromString(string contents) {
+    SourceBuffer buffer;
+    buffer.storage = std::move(contents);
+    buffer.bytes = buffer.storage.data();
+    buffer.byteCount = buffer.storage.size();
+    return buffer;
+}
+
+SourceBuffer SourceBuffer::fromFile(const string& filePath) {
+#ifdef _WIN32
+    ifstream file(filePath, ios::binary | ios::ate);
+    if (!file) {
+        throw runtime_error("Could not open file: " + filePath);
+    }
+    string contents(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(&contents[0], static_cast<streamsize>(contents.size()));
+    return fromString(std::move(contents));
+#else
+    if (filePath == "-") {
+        return fromString(readDescriptor(STDIN_FILENO, filePath));
+    }
+
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Could not open file: " + filePath);
+    }
+
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw runtime_error("Could not open file: " + filePath);
+    }
+
+    // Only non-empty regular files can be mapped, everything else is streamed
+    size_t length = static_cast<size_t>(info.st_size);
+    void* address = MAP_FAILED;
+    if (S_ISREG(info.st_mode) && length > 0) {
+        address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (address == MAP_FAILED) {
+        try {
+            SourceBuffer buffer = fromString(readDescriptor(fd, filePath));
+            ::close(fd);
+            return buffer;
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+    }
+    ::close(fd);  // The mapping keeps the file alive
+    ::madvise(address, length, MADV_SEQUENTIAL);
+
+    SourceBuffer buffer;
+    buffer.bytes = static_cast<const char*>(address);
+    buffer.byteCount = length;
+    buffer.mapped = true;
+    return buffer;
+#endif
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept {
+    *this = std::move(other);
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    mapped = other.mapped;
+    byteCount = other.byteCount;
+    storage = std::move(other.storage);
+    bytes = mapped ? other.bytes : storage.data();
+    other.bytes = nullptr;
+    other.byteCount = 0;
+    other.mapped = false;
+    return *this;
+}
+
+SourceBuffer::~SourceBuffer() {
+    release();
+}
+
+void SourceBuffer::release() {
+#ifndef _WIN32
+    if (mapped) {
+        ::munmap(const_cast<char*>(bytes), byteCount);
+    }
+#endif
+    bytes = nullptr;
+    byteCount = 0;
+    mapped = false;
+    storage.clear();
+}
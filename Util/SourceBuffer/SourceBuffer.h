@@ -0,0 +1,36 @@
+#ifndef TC3002_COMPILER_SOURCEBUFFER_H
+#define TC3002_COMPILER_SOURCEBUFFER_H
+
+#include <string>
+#include <string_view>
+
+// Read-only view of a whole source file. Regular files are memory-mapped so
+// loading them costs page faults instead of copies; pipes, character devices
+// and stdin ("-") are read into an owned buffer instead.
+class SourceBuffer {
+private:
+    const char* bytes = nullptr;
+    size_t byteCount = 0;
+    bool mapped = false;
+    std::string storage;  // Backing store when the input could not be mapped
+
+    SourceBuffer() = default;
+    void release();
+
+public:
+    static SourceBuffer fromFile(const std::string& filePath);
+    static SourceBuffer fromString(std::string contents);
+
+    SourceBuffer(SourceBuffer&& other) noexcept;
+    SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    ~SourceBuffer();
+
+    std::string_view view() const { return {bytes, byteCount}; }
+    const char* data() const { return bytes; }
+    size_t size() const { return byteCount; }
+    bool isMapped() const { return mapped; }
+};
+
+#endif //TC3002_COMPILER_SOURCEBUFFER_H
@@ -0,0 +1,91 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        queues.push_back(make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(function<void()> task) {
+    // Spread submissions round-robin, stealing evens out the rest
+    WorkQueue& queue = *queues[nextQueue++ % queues.size()];
+    unfinished++;
+    {
+        lock_guard<mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        lock_guard<mutex> lock(stateMutex);
+        queued++;
+    }
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    unique_lock<mutex> lock(stateMutex);
+    allDone.wait(lock, [this] { return unfinished == 0; });
+}
+
+bool ThreadPool::tryTake(size_t self, function<void()>& task) {
+    // Own deque first (newest task, still warm in cache)...
+    {
+        WorkQueue& own = *queues[self];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // ...then the oldest task of another worker
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        WorkQueue& victim = *queues[(self + offset) % queues.size()];
+        lock_guard<mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t self) {
+    while (true) {
+        function<void()> task;
+        if (tryTake(self, task)) {
+            queued--;
+            task();
+            if (--unfinished == 0) {
+                lock_guard<mutex> lock(stateMutex);
+                allDone.notify_all();
+            }
+            continue;
+        }
+
+        unique_lock<mutex> lock(stateMutex);
+        workAvailable.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
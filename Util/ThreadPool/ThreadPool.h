@@ -0,0 +1,49 @@
+#ifndef TC3002_COMPILER_THREADPOOL_H
+#define TC3002_COMPILER_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool with one task deque per worker. Workers take tasks from
+// the back of their own deque and, when it runs dry, steal from the front of
+// the others, so uneven task sizes still keep every core busy.
+class ThreadPool {
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};      // Tasks sitting in some deque
+    std::atomic<size_t> unfinished{0};  // Tasks submitted but not yet completed
+    std::atomic<size_t> nextQueue{0};
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    bool stopping = false;
+
+    bool tryTake(size_t self, std::function<void()>& task);
+    void workerLoop(size_t self);
+
+public:
+    // Defaults to one worker per hardware thread
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    // Blocks until every submitted task has finished
+    void wait();
+    size_t size() const { return workers.size(); }
+};
+
+#endif //TC3002_COMPILER_THREADPOOL_H
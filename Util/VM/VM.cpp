@@ -0,0 +1,243 @@
+#include "VM.h"
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+VM::VM(const BytecodeProgram& program, BufferedWriter& out, FILE* in)
+    : program(program), out(out), in(in), globals(program.globalCount, 0), stack(STACK_SIZE, 0) {}
+
+void VM::run() {
+    frames.clear();
+    frames.reserve(256);
+    execute();
+    out.flush();
+}
+
+/* I/O */
+static void writeUtf8(BufferedWriter& out, int32_t codePoint) {
+    auto c = static_cast<uint32_t>(codePoint);
+    if (c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) c = 0xFFFD;
+    if (c < 0x80) {
+        out << static_cast<char>(c);
+    } else if (c < 0x800) {
+        out << static_cast<char>(0xC0 | (c >> 6)) << static_cast<char>(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out << static_cast<char>(0xE0 | (c >> 12)) << static_cast<char>(0x80 | ((c >> 6) & 0x3F))
+            << static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+        out << static_cast<char>(0xF0 | (c >> 18)) << static_cast<char>(0x80 | ((c >> 12) & 0x3F))
+            << static_cast<char>(0x80 | ((c >> 6) & 0x3F)) << static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+// One line of input without its line break; false at end of input
+static bool readLine(FILE* in, string& line) {
+    line.clear();
+    int c;
+    while ((c = fgetc(in)) != EOF && c != '\n') line.push_back(static_cast<char>(c));
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    return c != EOF || !line.empty();
+}
+
+int32_t VM::readInteger() {
+    // Anything that is not a 32-bit integer reads as 0
+    out.flush();
+    string line;
+    readLine(in, line);
+    size_t start = line.find_first_not_of(" \t");
+    size_t end = line.find_last_not_of(" \t");
+    if (start == string::npos) return 0;
+    if (line[start] == '+') start++;
+    int32_t value = 0;
+    auto result = from_chars(line.data() + start, line.data() + end + 1, value);
+    return result.ec == errc() && result.ptr == line.data() + end + 1 ? value : 0;
+}
+
+int32_t VM::readString() {
+    // The line's code points, decoded from UTF-8
+    out.flush();
+    string line;
+    readLine(in, line);
+    vector<int32_t> codePoints;
+    codePoints.reserve(line.size());
+    for (size_t i = 0; i < line.size();) {
+        auto byte = static_cast<unsigned char>(line[i]);
+        int length = byte < 0x80 ? 1 : byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 1;
+        if (i + length > line.size()) length = 1;
+        int32_t c = length == 1 ? byte : byte & (0x3F >> (length - 1));
+        for (int k = 1; k < length; k++) c = (c << 6) | (line[i + k] & 0x3F);
+        codePoints.push_back(c);
+        i += length;
+    }
+    return arrays.create(codePoints.data(), codePoints.size());
+}
+
+void VM::printString(int32_t handle) {
+    int32_t size = arrays.size(handle);
+    const int32_t* elements = arrays.data(handle);
+    for (int32_t i = 0; i < size; i++) writeUtf8(out, elements[i]);
+}
+
+void VM::collect(const int32_t* registers) {
+    // No frame has more than MAX_REGISTERS, and none is above the current one
+    const int32_t* end = stack.data() + stack.size();
+    const int32_t* top = min(registers + MAX_REGISTERS, end);
+    arrays.collect({{globals.data(), globals.data() + globals.size()}, {stack.data(), top}});
+}
+
+/* Dispatch */
+static inline int32_t wrap(uint32_t value) { return static_cast<int32_t>(value); }
+
+void VM::execute() {
+    const Instruction* code = program.code.data();
+    const Instruction* pc = code + program.functions[program.entry].entry;
+    int32_t* r = stack.data();
+    int32_t* stackEnd = stack.data() + stack.size();
+    int32_t* g = globals.data();
+    uint64_t count = 0;
+
+#if QUETZAL_COMPUTED_GOTO
+    static const void* const labels[] = {
+#define QUETZAL_OPCODE_LABEL(name, operands) &&op_##name,
+        QUETZAL_OPCODES(QUETZAL_OPCODE_LABEL)
+#undef QUETZAL_OPCODE_LABEL
+    };
+#define CASE(name) op_##name:
+#define DISPATCH() do { count++; goto *labels[static_cast<uint8_t>(pc->op)]; } while (0)
+#else
+#define CASE(name) case Opcode::name:
+#define DISPATCH() do { count++; goto dispatch; } while (0)
+#endif
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+#define JUMP(target) do { pc = code + (target); DISPATCH(); } while (0)
+#define A r[pc->a]
+#define B r[pc->b]
+#define C r[pc->c]
+#define COLLECT() do { if (arrays.collectionDue()) collect(r); } while (0)
+
+    try {
+#if QUETZAL_COMPUTED_GOTO
+        DISPATCH();
+#else
+        count++;
+    dispatch:
+        switch (pc->op) {
+#endif
+        CASE(MOV) A = B; NEXT();
+        CASE(LOADI) A = pc->imm; NEXT();
+        CASE(GETG) A = g[pc->imm]; NEXT();
+        CASE(SETG) g[pc->imm] = A; NEXT();
+
+        CASE(ADD) A = wrap(static_cast<uint32_t>(B) + static_cast<uint32_t>(C)); NEXT();
+        CASE(SUB) A = wrap(static_cast<uint32_t>(B) - static_cast<uint32_t>(C)); NEXT();
+        CASE(MUL) A = wrap(static_cast<uint32_t>(B) * static_cast<uint32_t>(C)); NEXT();
+        CASE(DIV) {
+            int32_t divisor = C;
+            if (divisor == 0) throw runtime_error("Division by zero");
+            A = divisor == -1 ? wrap(0u - static_cast<uint32_t>(B)) : B / divisor;
+            NEXT();
+        }
+        CASE(MOD) {
+            int32_t divisor = C;
+            if (divisor == 0) throw runtime_error("Division by zero");
+            A = divisor == -1 ? 0 : B % divisor;
+            NEXT();
+        }
+        CASE(ADDI) A = wrap(static_cast<uint32_t>(B) + static_cast<uint32_t>(pc->imm)); NEXT();
+        CASE(NEG) A = wrap(0u - static_cast<uint32_t>(B)); NEXT();
+        CASE(NOT) A = B == 0; NEXT();
+        CASE(BOOL) A = B != 0; NEXT();
+
+        CASE(EQ) A = B == C; NEXT();
+        CASE(NE) A = B != C; NEXT();
+        CASE(LT) A = B < C; NEXT();
+        CASE(LE) A = B <= C; NEXT();
+        CASE(GT) A = B > C; NEXT();
+        CASE(GE) A = B >= C; NEXT();
+        CASE(INC) A = wrap(static_cast<uint32_t>(A) + 1); NEXT();
+        CASE(DEC) A = wrap(static_cast<uint32_t>(A) - 1); NEXT();
+
+        CASE(JMP) JUMP(pc->imm);
+        CASE(JZ) if (A == 0) JUMP(pc->imm); NEXT();
+        CASE(JNZ) if (A != 0) JUMP(pc->imm); NEXT();
+        CASE(JEQ) if (A == B) JUMP(pc->imm); NEXT();
+        CASE(JNE) if (A != B) JUMP(pc->imm); NEXT();
+        CASE(JLT) if (A < B) JUMP(pc->imm); NEXT();
+        CASE(JLE) if (A <= B) JUMP(pc->imm); NEXT();
+        CASE(JGT) if (A > B) JUMP(pc->imm); NEXT();
+        CASE(JGE) if (A >= B) JUMP(pc->imm); NEXT();
+
+        CASE(CALL) {
+            const BytecodeFunction& callee = program.functions[pc->imm];
+            int32_t* frame = r + pc->a;
+            if (frame + callee.registerCount > stackEnd) throw runtime_error("Stack overflow");
+            frames.push_back({pc + 1, r});
+            r = frame;
+            JUMP(callee.entry);
+        }
+        CASE(RET) {
+            r[0] = A;
+            Frame frame = frames.back();
+            frames.pop_back();
+            r = frame.registers;
+            pc = frame.returnPc;
+            DISPATCH();
+        }
+        CASE(RET0) {
+            r[0] = 0;
+            Frame frame = frames.back();
+            frames.pop_back();
+            r = frame.registers;
+            pc = frame.returnPc;
+            DISPATCH();
+        }
+
+        CASE(PRINTI) out << A; NEXT();
+        CASE(PRINTC) writeUtf8(out, A); NEXT();
+        CASE(PRINTS) printString(A); NEXT();
+        CASE(PRINTLN) out << '\n'; NEXT();
+        CASE(READI) A = readInteger(); NEXT();
+        CASE(READS) COLLECT(); A = readString(); NEXT();
+        CASE(NEW) COLLECT(); A = arrays.create(B); NEXT();
+        CASE(SIZE) A = arrays.size(B); NEXT();
+        CASE(APPEND) COLLECT(); arrays.add(A, B); NEXT();
+        CASE(GET) A = arrays.get(B, C); NEXT();
+        CASE(SET) arrays.set(A, B, C); NEXT();
+        CASE(GETU) A = arrays.getUnchecked(B, C); NEXT();
+        CASE(SETU) arrays.setUnchecked(A, B, C); NEXT();
+        CASE(ARRAY) COLLECT(); A = arrays.create(pc->imm); NEXT();
+        CASE(SETK) arrays.set(A, pc->imm, B); NEXT();
+        CASE(STRING) {
+            COLLECT();
+            const vector<int32_t>& text = program.strings[pc->imm];
+            A = arrays.createShared(text.data(), text.size());
+            NEXT();
+        }
+        CASE(HALT) {
+            executed += count;
+            return;
+        }
+#if !QUETZAL_COMPUTED_GOTO
+            case Opcode::Count:
+                break;
+        }
+        throw runtime_error("Invalid opcode");
+#endif
+    } catch (const runtime_error& e) {
+        executed += count;
+        uint32_t line = program.lines[pc - code];
+        throw runtime_error("[Line " + to_string(line) + "] Runtime Error: " + e.what());
+    }
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef A
+#undef B
+#undef C
+#undef COLLECT
+}
@@ -0,0 +1,64 @@
+#ifndef TC3002_COMPILER_VM_H
+#define TC3002_COMPILER_VM_H
+
+#include "../Bytecode/Bytecode.h"
+#include "../Output/BufferedWriter.h"
+#include "../Runtime/ArrayStore.h"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Computed-goto dispatch (one indirect jump per instruction, replicated at
+// the end of every handler) where the compiler supports labels as values,
+// a switch loop elsewhere. Define QUETZAL_SWITCH_DISPATCH to force the switch.
+#if defined(__GNUC__) && !defined(QUETZAL_SWITCH_DISPATCH)
+#define QUETZAL_COMPUTED_GOTO 1
+#else
+#define QUETZAL_COMPUTED_GOTO 0
+#endif
+
+// Runs a bytecode program. All frames share one register stack: a call
+// starts the callee's frame at its first argument register, so arguments
+// are never copied and the result lands where the caller expects it.
+// Before each allocation the array store may collect garbage.
+class VM {
+private:
+    struct Frame {
+        const Instruction* returnPc;
+        int32_t* registers;
+    };
+
+    static constexpr size_t STACK_SIZE = 1 << 20;  // Registers, shared by all frames
+
+    const BytecodeProgram& program;
+    BufferedWriter& out;
+    FILE* in;
+    ArrayStore arrays;
+    std::vector<int32_t> globals;
+    std::vector<int32_t> stack;
+    std::vector<Frame> frames;
+    uint64_t executed = 0;
+
+    void execute();
+    // Reclaims unreachable arrays; the roots are the globals and the
+    // registers up to the end of the frame at `registers`
+    void collect(const int32_t* registers);
+    int32_t readInteger();
+    int32_t readString();
+    void printString(int32_t handle);
+
+public:
+    // Program output goes to `out`, which is flushed before any input is read
+    VM(const BytecodeProgram& program, BufferedWriter& out, FILE* in = stdin);
+    VM(const VM&) = delete;
+    VM& operator=(const VM&) = delete;
+
+    // Runs the program to completion; runtime errors throw a runtime_error
+    // prefixed with the source line
+    void run();
+
+    uint64_t instructionsExecuted() const { return executed; }
+    const ArrayStore& arrayStore() const { return arrays; }
+};
+
+#endif //TC3002_COMPILER_VM_H
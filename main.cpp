@@ -1,47 +1,183 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
-#include <unordered_map>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "./Util/Lexer/Lexer.h"
-#include "./Util/FileUtils/FileUtils.h"
+#include "./Util/SourceBuffer/SourceBuffer.h"
 #include "./Util/Parser/Parser.h"
+#include "./Util/Semantic/SemanticAnalyzer.h"
+#include "./Util/Driver/Driver.h"
+#include "./Util/Output/BufferedWriter.h"
 
 using namespace std;
 
-// Prints individual token with line/column info
-void printToken(const Token& token) {
-    cout << "[" << token.line << ":" << token.column << "] "
-         << Lexer::tokenKindToString(token.kind)
-         << " '" << token.value << "'\n";
+// Prints how long a phase took and its throughput, when instrumentation is built in
+void printPhaseTiming(Phase phase, size_t amount, const char* unit) {
+    if (!QUETZAL_INSTRUMENTED) return;
+    double seconds = instrumentation::threadMetrics.phaseSeconds[static_cast<size_t>(phase)];
+    cout << "(" << instrumentation::phaseName(phase) << ": " << amount << " " << unit
+         << " in " << seconds * 1000 << " ms";
+    if (seconds > 0) cout << ", " << static_cast<uint64_t>(amount / seconds) << " " << unit << "/s";
+    cout << ")\n";
 }
 
-// Generates token statistics report
-void printTokenStatistics(const vector<Token>& tokens) {
-    unordered_map<TokenKind, int> tokenCounts;
-    int totalTokens = 0;
-
-    // Count non-whitespace, non-comment tokens
-    for (const auto& token : tokens) {
-        if (token.kind != TokenKind::SPACE &&
-            token.kind != TokenKind::LINE_COMMENT &&
-            token.kind != TokenKind::BLOCK_COMMENT) {
-            tokenCounts[token.kind]++;
-            totalTokens++;
+void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options] <file|directory>...\n"
+         << "       " << program << "                      (interactive, prompts for one file)\n\n"
+         << "Files are lexed, parsed and checked silently; errors go to stderr and the exit\n"
+         << "status is 1 if any file fails. Outputs are opt-in:\n"
+         << "  --tokens              print the token stream\n"
+         << "  --tokens-binary FILE  write tokens in the compact binary format to FILE\n"
+         << "  --stats               print token statistics\n"
+         << "  --ast                 print the syntax tree\n"
+         << "  --bytecode            print the compiled bytecode\n"
+         << "  --run                 run the programs on the VM, one after another\n"
+         << "  --asm                 print the x86-64 assembly\n"
+         << "  --native              link a native executable next to each source file\n"
+         << "  --c                   print the program translated to C\n"
+         << "  --native-c            like --native, but compile the C translation with cc -O2\n"
+         << "  -o FILE               name of the native executable (one input file only)\n"
+         << "  -O0                   skip the optimiser (folding, dead code, loops)\n"
+         << "  --parse               print a result line per file and a summary\n"
+         << "  --report FILE         write a JSON metrics report to FILE ('-' for stdout)\n"
+         << "  -j, --jobs N          compile with N threads (default: one per core)\n";
+}
+
+// Headless mode: compiles every file or directory on the command line in parallel
+int runBatch(int argc, char* argv[]) {
+    CompileOptions options;
+    bool printResults = false;
+    size_t jobs = 0;
+    string reportPath;  // JSON metrics report, "-" for stdout
+    string binaryPath;
+    vector<string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            if (i + 1 >= argc) throw runtime_error(arg + " expects a value");
+            return argv[++i];
+        };
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "--tokens") {
+            options.printTokens = true;
+        } else if (arg == "--tokens-binary") {
+            options.binaryTokens = true;
+            binaryPath = value();
+        } else if (arg == "--stats") {
+            options.printStatistics = true;
+        } else if (arg == "--ast") {
+            options.printAst = true;
+        } else if (arg == "--bytecode") {
+            options.printBytecode = true;
+        } else if (arg == "--run") {
+            options.run = true;
+        } else if (arg == "--asm") {
+            options.printAssembly = true;
+        } else if (arg == "--native") {
+            options.native = true;
+        } else if (arg == "--c") {
+            options.printC = true;
+        } else if (arg == "--native-c") {
+            options.native = true;
+            options.viaC = true;
+        } else if (arg == "-o") {
+            options.native = true;
+            options.outputPath = value();
+        } else if (arg == "-O0") {
+            options.optimize = false;
+        } else if (arg == "--parse") {
+            printResults = true;
+        } else if (arg == "--report") {
+            reportPath = value();
+            options.collectMetrics = true;
+        } else if (arg == "-j" || arg == "--jobs") {
+            jobs = stoul(value());
+        } else if (arg.rfind("-j", 0) == 0 && arg.size() > 2) {
+            jobs = stoul(arg.substr(2));
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            throw runtime_error("unknown option " + arg);
+        } else {
+            inputs.push_back(arg);
         }
     }
 
-    // Print report
-    cout << "\n=== Token Analysis ===\n";
-    cout << "Total significant tokens: " << totalTokens << "\n";
-    cout << "Distinct token types: " << tokenCounts.size() << "\n\n";
-    cout << "Token frequency:\n";
-    cout << "----------------\n";
+    vector<string> files = collectSourceFiles(inputs);
+    if (files.empty()) {
+        cerr << "Error: no source files found\n";
+        return 2;
+    }
+
+    if (!options.outputPath.empty() && files.size() != 1) {
+        cerr << "Error: -o needs exactly one input file\n";
+        return 2;
+    }
+
+    FILE* binaryFile = nullptr;
+    if (options.binaryTokens) {
+        binaryFile = fopen(binaryPath.c_str(), "wb");
+        if (!binaryFile) throw runtime_error("cannot write tokens to " + binaryPath);
+    }
+
+    if (jobs == 0) jobs = max(1u, thread::hardware_concurrency());
+    if (options.run) jobs = 1;  // Programs share stdin and stdout
+    auto start = chrono::steady_clock::now();
+    vector<FileResult> results;
+    {
+        BufferedWriter out(stdout);
+        BufferedWriter binary(binaryFile);
+        if (binaryFile) writeBinaryHeader(binary);
+        results = compileFiles(files, jobs, options, out, binaryFile ? &binary : nullptr);
+    }
+    chrono::duration<double> wall = chrono::steady_clock::now() - start;
+    if (binaryFile) fclose(binaryFile);
+
+    // Reported in input order, independent of which worker finished first
+    size_t failed = 0;
+    BufferedWriter out(stdout);
+    for (const auto& result : results) {
+        if (result.success) {
+            if (printResults) {
+                out << "OK    " << result.path << " (" << result.nodeCount << " nodes)\n";
+            }
+            continue;
+        }
+        failed++;
+        if (printResults) out << "FAIL  " << result.path << "\n";
+        for (const auto& diagnostic : result.diagnostics) {
+            cerr << result.path << ": " << diagnostic << "\n";
+        }
+    }
+    if (printResults) out << "\n" << results.size() << " files, " << failed << " failed\n";
+    out.flush();
 
-    for (const auto& [kind, count] : tokenCounts) {
-        cout << Lexer::tokenKindToString(kind) << ": " << count << "\n";
+    if (reportPath == "-") {
+        writeJsonReport(cout, results, jobs, wall.count());
+    } else if (!reportPath.empty()) {
+        ofstream report(reportPath);
+        if (!report) throw runtime_error("cannot write report to " + reportPath);
+        writeJsonReport(report, results, jobs, wall.count());
     }
+    return failed == 0 ? 0 : 1;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        try {
+            return runBatch(argc, argv);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 2;
+        }
+    }
+
     // Get input file
     string filePath;
     cout << "Quetzal Compiler\n";
@@ -51,29 +187,61 @@ int main() {
 
     try {
         // Phase 1: Lexical Analysis
-        cout << "\n[1/2] Lexical Analysis\n";
+        cout << "\n[1/3] Lexical Analysis\n";
         cout << "----------------------\n";
 
-        string source = readFileContents(filePath);
+        SourceBuffer source = SourceBuffer::fromFile(filePath);
         Lexer lexer(source);
-        auto tokens = lexer.tokenize();
+        Interner symbols;
+        lexer.useInterner(symbols);
+        TokenBuffer tokens;
+        {
+            QUETZAL_PHASE(Lex);
+            lexer.tokenize(tokens);
+        }
+        printPhaseTiming(Phase::Lex, source.size(), "bytes");
 
-        // Display token stream
+        // Display token stream and statistics
         cout << "Token stream:\n";
         cout << "-------------\n";
-        for (const auto& token : tokens) {
-            printToken(token);
+        cout.flush();
+        {
+            BufferedWriter out(stdout);
+            writeTokens(out, tokens, source.view());
+            writeTokenStatistics(out, tokens);
         }
 
-        // Show token statistics
-        printTokenStatistics(tokens);
-
         // Phase 2: Syntax Analysis
-        cout << "\n[2/2] Syntax Analysis\n";
+        cout << "\n[2/3] Syntax Analysis\n";
         cout << "----------------------\n";
 
-        Parser parser(tokens);
-        parser.parse();
+        size_t tokenCount = tokens.size();
+        Ast ast = [&] {
+            QUETZAL_PHASE(Parse);
+            Parser parser(std::move(tokens), source.view());
+            return parser.parse();
+        }();
+        cout << "Parsing completed successfully!\n";
+        printPhaseTiming(Phase::Parse, tokenCount, "tokens");
+        cout << "Syntax tree: " << ast.size() << " nodes\n";
+
+        // Phase 3: Semantic Analysis
+        cout << "\n[3/3] Semantic Analysis\n";
+        cout << "------------------------\n";
+
+        vector<string> diagnostics;
+        ProgramInfo program = [&] {
+            QUETZAL_PHASE(Analyze);
+            return SemanticAnalyzer(ast, source.view(), symbols).analyze(diagnostics);
+        }();
+        if (!diagnostics.empty()) {
+            string message = diagnostics.front();
+            for (size_t i = 1; i < diagnostics.size(); i++) message += '\n' + diagnostics[i];
+            throw runtime_error(message);
+        }
+        cout << "Semantic analysis completed successfully!\n";
+        printPhaseTiming(Phase::Analyze, ast.size(), "nodes");
+        cout << program.functions.size() << " functions, " << program.globals.size() << " globals\n";
 
         cout << "\n✓ Compilation successful!\n";
         cout << "No syntax errors found in " << filePath << "\n";
@@ -88,32 +256,3 @@ int main() {
 
     return 0;
 }
-/*
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <source_file.quetzal>\n";
-        return 1;
-    }
-
-    try {
-        string source = readFileContents(argv[1]);
-        Lexer lexer(source);
-
-        cout << "Tokenizing file: " << argv[1] << endl;
-        auto tokens = lexer.tokenize();
-
-        cout << "\n=== Token Stream ===\n";
-        for (const auto& token : tokens) {
-            printToken(token);
-        }
-
-        cout << "\n=== Token Analysis ===\n";
-
-    } catch (const exception& e) {
-        cerr << "\nERROR: " << e.what() << endl;
-        return 1;
-    }
-
-    return 0;
-}
-*/
\ No newline at end of file